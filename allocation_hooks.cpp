@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include "memory.hpp"
+
+// Replaces the global allocation functions for the whole program; the array and nothrow forms go through these.
+
+void *operator new(std::size_t size) {
+    if (size == 0) {
+        size = 1;
+    }
+    while (true) {
+        if (void *p = std::malloc(size)) {
+            count_heap_allocation(p, size);
+            return p;
+        }
+        const std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void operator delete(void *p) noexcept {
+    count_heap_deallocation(p);
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    operator delete(p);
+}
+
+// std::pmr::new_delete_resource allocates through the aligned forms
+void *operator new(std::size_t size, const std::align_val_t alignment) {
+    const auto align = static_cast<std::size_t>(alignment);
+    // aligned_alloc wants a multiple of the alignment
+    size = (std::max<std::size_t>(size, 1) + align - 1) / align * align;
+    while (true) {
+        if (void *p = std::aligned_alloc(align, size)) {
+            count_heap_allocation(p, size);
+            return p;
+        }
+        const std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+    operator delete(p);
+}
@@ -0,0 +1,52 @@
+#include "analysis.hpp"
+#include <algorithm>
+#include "cfg.hpp"
+#include "constant_propagation.hpp"
+#include "dfg.hpp"
+#include "intern.hpp"
+#include "trace.hpp"
+
+std::vector<UnusedAssignment> sorted_unused_assignments(const DfgNodeUnusedAssignments &unused_assignments,
+                                                        const LineIndex &lines) {
+    std::vector<UnusedAssignment> result;
+    sorted_unused_assignments(unused_assignments, lines, result);
+    return result;
+}
+
+void sorted_unused_assignments(const DfgNodeUnusedAssignments &unused_assignments, const LineIndex &lines,
+                               std::vector<UnusedAssignment> &result) {
+    TraceScope trace{"sort_results"};
+    result.clear();
+    result.reserve(unused_assignments.assignments.size());
+    for (const auto &assignment: unused_assignments.assignments) {
+        const auto [line, column] = lines.locate(assignment->span.start);
+        result.push_back(UnusedAssignment{
+                .name = assignment->name.name,
+                .start = assignment->span.start,
+                .end = assignment->span.end,
+                .line = line,
+                .column = column,
+        });
+    }
+    std::ranges::sort(result,
+                      [](const auto &a, const auto &b) {
+                          return a.start < b.start;
+                      });
+}
+
+std::vector<UnusedAssignment> analyse_source(const std::string_view src, const PhaseMemory &memory,
+                                             const bool hash_cons) {
+    ExprInterner interner;
+    ParserState state{Lexer{src}, memory.parse, hash_cons ? &interner : nullptr};
+    const Program p = parse_program(state);
+    Cfg cfg = build_cfg(p, memory.cfg);
+    ConstantState constants;
+    fold_constant_branches(cfg, constants);
+    const Dfg dfg = build_dfg(cfg, memory.dfg);
+    DfgNodeOutputs outputs;
+    compute_whole_program_required_outputs(p, outputs);
+
+    DfgNodeUnusedAssignments unused_assignments;
+    analyse_dfg(dfg, outputs, unused_assignments, memory.analysis);
+    return sorted_unused_assignments(unused_assignments, state.lexer.lines);
+}
@@ -0,0 +1,34 @@
+#ifndef DFA_SAMPLE_ANALYSIS_HPP
+#define DFA_SAMPLE_ANALYSIS_HPP
+
+#include "ast.hpp"
+#include "dfg_analysis.hpp"
+#include "memory.hpp"
+#include "parse.hpp"
+
+struct UnusedAssignment {
+    std::string_view name;
+    // offsets into the whole source, which may be too big for a Span
+    size_t start;
+    size_t end;
+    // 1-based, columns in bytes
+    size_t line;
+    size_t column;
+};
+
+// Sorts the results of analyse_dfg by span start, locating them with the line index of the source they were
+// parsed from.
+std::vector<UnusedAssignment> sorted_unused_assignments(const DfgNodeUnusedAssignments &unused_assignments,
+                                                        const LineIndex &lines);
+
+// The same, replacing the contents of `result` while keeping its capacity.
+void sorted_unused_assignments(const DfgNodeUnusedAssignments &unused_assignments, const LineIndex &lines,
+                               std::vector<UnusedAssignment> &result);
+
+// Runs the whole pipeline (parse, CFG, DFG, liveness) over `src`, each phase allocating from its resource in
+// `memory`, and hash-consing the expressions if `hash_cons` is set. The results are sorted by span start, and
+// their names point into `src`.
+std::vector<UnusedAssignment> analyse_source(std::string_view src, const PhaseMemory &memory = {},
+                                             bool hash_cons = false);
+
+#endif //DFA_SAMPLE_ANALYSIS_HPP
@@ -5,17 +5,23 @@
 #ifndef DFA_SAMPLE_AST_HPP
 #define DFA_SAMPLE_AST_HPP
 
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <variant>
 #include <vector>
 #include <memory>
 
+// Offsets into the buffer the lexer was given. They are 32-bit to keep the AST small, which limits that buffer
+// to 4 GiB; bigger inputs have to be lexed a statement at a time, with spans relative to each statement (see
+// IncrementalAnalysis).
 struct Span {
-    size_t start;
-    size_t end;
+    uint32_t start;
+    uint32_t end;
 
-    bool operator==(const Span &other) const {
+    static constexpr size_t max_offset = UINT32_MAX;
+
+    constexpr bool operator==(const Span &other) const {
         return start == other.start && end == other.end;
     }
 };
@@ -24,15 +30,15 @@ struct Name {
     std::string_view name;
     Span span;
 
-    bool operator==(const Name &other) const {
+    constexpr bool operator==(const Name &other) const {
         return name == other.name;
     }
 
-    bool operator==(const char *s) const {
+    constexpr bool operator==(const char *s) const {
         return name == s;
     }
 
-    bool operator<(const Name &other) const {
+    constexpr bool operator<(const Name &other) const {
         return name < other.name;
     }
 };
@@ -41,7 +47,7 @@ struct Constant {
     int value;
     Span span;
 
-    bool operator==(const Constant &other) const {
+    constexpr bool operator==(const Constant &other) const {
         return value == other.value;
     }
 };
@@ -0,0 +1,181 @@
+#include "batch.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <glob.h>
+#include <unistd.h>
+#include "analysis.hpp"
+#include "region_memo.hpp"
+#include "trace.hpp"
+#include "work_stealing.hpp"
+
+struct BatchFileResult {
+    std::string report;
+    bool ok = false;
+    std::chrono::steady_clock::duration latency{};
+};
+
+static bool expand_input(const std::string &input, std::vector<std::string> &files) {
+    if (input.starts_with('@')) {
+        std::ifstream fin(input.substr(1));
+        if (!fin) {
+            std::cerr << "Failed to open file " << input.substr(1) << std::endl;
+            return false;
+        }
+        std::string line;
+        while (std::getline(fin, line)) {
+            if (!line.empty()) {
+                files.push_back(line);
+            }
+        }
+        return true;
+    }
+
+    std::error_code ec;
+    if (std::filesystem::is_directory(input, ec)) {
+        std::vector<std::string> found;
+        for (const auto &entry: std::filesystem::recursive_directory_iterator(input, ec)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".aaa") {
+                found.push_back(entry.path().string());
+            }
+        }
+        if (ec) {
+            std::cerr << "Failed to list directory " << input << ": " << ec.message() << std::endl;
+            return false;
+        }
+        // directory order is up to the file system
+        std::ranges::sort(found);
+        files.insert(files.end(), found.begin(), found.end());
+        return true;
+    }
+
+    if (input.find_first_of("*?[") != std::string::npos) {
+        glob_t matches{};
+        const int status = glob(input.c_str(), 0, nullptr, &matches);
+        if (status != 0) {
+            globfree(&matches);
+            std::cerr << "No files match " << input << std::endl;
+            return false;
+        }
+        for (size_t i = 0; i < matches.gl_pathc; i++) {
+            files.emplace_back(matches.gl_pathv[i]);
+        }
+        globfree(&matches);
+        return true;
+    }
+
+    files.push_back(input);
+    return true;
+}
+
+bool expand_batch_inputs(const std::vector<std::string> &inputs, std::vector<std::string> &files) {
+    for (const auto &input: inputs) {
+        if (!expand_input(input, files)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void analyse_file(const std::string &path, const ReportFormat format, RegionMemo *memo,
+                         BatchFileResult &result) {
+    ReportBuffer report;
+    const std::unique_ptr<Reporter> reporter = make_reporter(format, true);
+    try {
+        std::ifstream fin(path);
+        if (!fin) {
+            throw std::runtime_error("Failed to open file " + path);
+        }
+        std::stringstream buffer;
+        buffer << fin.rdbuf();
+        const std::string src = buffer.str();
+        report_file(*reporter, report, path, src,
+                    memo != nullptr ? analyse_source_memoized(src, *memo) : analyse_source(src));
+        result.ok = true;
+    } catch (const std::exception &e) {
+        reporter->begin_file(report, path, "");
+        reporter->error(report, e.what());
+        reporter->end_file(report);
+        result.ok = false;
+    }
+    result.report = report.take();
+}
+
+int run_batch(const std::vector<std::string> &inputs, const size_t threads, const ReportFormat format,
+              const size_t memo_entries) {
+    std::vector<std::string> files;
+    if (!expand_batch_inputs(inputs, files)) {
+        return 1;
+    }
+    std::optional<RegionMemo> memo;
+    if (memo_entries != 0) {
+        memo.emplace(memo_entries);
+    }
+
+    std::vector<BatchFileResult> results(files.size());
+    std::vector<bool> done(files.size());
+    size_t next_output = 0;
+    std::mutex output_mutex;
+    ReportBuffer out{STDOUT_FILENO};
+    const std::unique_ptr<Reporter> run_reporter = make_reporter(format, true);
+    run_reporter->begin_run(out);
+
+    const auto start = std::chrono::steady_clock::now();
+    run_work_stealing(files.size(), threads, [&](size_t, const size_t index) {
+        const auto file_start = std::chrono::steady_clock::now();
+        TraceScope trace{"file"};
+        trace.arg(0, "index", index);
+        BatchFileResult &result = results[index];
+        analyse_file(files[index], format, memo ? &*memo : nullptr, result);
+        result.latency = std::chrono::steady_clock::now() - file_start;
+
+        // whoever completes the oldest pending file writes out everything that is ready after it
+        std::lock_guard lock{output_mutex};
+        done[index] = true;
+        for (; next_output < files.size() && done[next_output]; next_output++) {
+            run_reporter->append_file(out, results[next_output].report);
+            std::string().swap(results[next_output].report);
+        }
+    });
+    run_reporter->end_run(out);
+    const bool output_written = out.flush();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::vector<std::chrono::steady_clock::duration> latencies;
+    latencies.reserve(results.size());
+    size_t failed = 0;
+    for (const auto &result: results) {
+        latencies.push_back(result.latency);
+        if (!result.ok) {
+            failed++;
+        }
+    }
+    const auto percentile = [&](const double p) {
+        if (latencies.empty()) {
+            return 0.0;
+        }
+        const auto nth = latencies.begin() + static_cast<ptrdiff_t>(p * static_cast<double>(latencies.size() - 1));
+        std::nth_element(latencies.begin(), nth, latencies.end());
+        return std::chrono::duration<double, std::milli>(*nth).count();
+    };
+    std::cerr << "batch: " << files.size() << " file(s), " << failed << " failed, "
+              << elapsed.count() << " s, "
+              << static_cast<double>(files.size()) / elapsed.count() << " files/s, "
+              << "p50 " << percentile(0.5) << " ms, p99 " << percentile(0.99) << " ms per file"
+              << std::endl;
+    if (memo) {
+        const size_t lookups = memo->hit_count() + memo->miss_count();
+        std::cerr << "memo: " << memo->hit_count() << " hit(s), " << memo->miss_count() << " miss(es), "
+                  << (lookups == 0 ? 0.0 : 100.0 * static_cast<double>(memo->hit_count()) / static_cast<double>(lookups))
+                  << "% hit rate" << std::endl;
+    }
+    if (!output_written) {
+        std::cerr << "error: failed to write output: " << std::strerror(out.error()) << std::endl;
+    }
+    return failed == 0 && output_written ? 0 : 1;
+}
@@ -0,0 +1,18 @@
+#ifndef DFA_SAMPLE_BATCH_HPP
+#define DFA_SAMPLE_BATCH_HPP
+
+#include <string>
+#include <vector>
+#include "reporter.hpp"
+
+// Appends the files named by `inputs` to `files`. An input is a directory (searched recursively for .aaa files),
+// a glob pattern, `@file` for a file with one path per line, or a plain file path.
+bool expand_batch_inputs(const std::vector<std::string> &inputs, std::vector<std::string> &files);
+
+// Analyses the files named by `inputs` on `threads` threads (all hardware threads if 0). Reports are written to
+// stdout in input order as soon as all the files before them are done, followed by throughput and latency
+// statistics on stderr. If `memo_entries` is not 0, the files share a RegionMemo of that many entries, and its hit
+// rate is reported too.
+int run_batch(const std::vector<std::string> &inputs, size_t threads, ReportFormat format, size_t memo_entries = 0);
+
+#endif //DFA_SAMPLE_BATCH_HPP
@@ -0,0 +1,452 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "analysis.hpp"
+#include "cfg.hpp"
+#include "constant_propagation.hpp"
+#include "constexpr_analysis.hpp"
+#include "dfg.hpp"
+#include "dfg_analysis.hpp"
+#include "intern.hpp"
+#include "memory.hpp"
+#include "parse.hpp"
+#include "program_generator.hpp"
+#include "reporter.hpp"
+
+// Benchmarks every phase of the pipeline over generated programs of increasing size, and fits how the time of
+// each phase grows with the program: a slope near 1 on a log-log scale is linear, near 2 is quadratic.
+
+struct BenchOptions {
+    uint64_t seed = 1;
+    std::vector<size_t> sizes{250, 500, 1000, 2000};
+    std::vector<ProgramShape> shapes{std::begin(all_program_shapes), std::end(all_program_shapes)};
+    double min_time = 0.05;
+    size_t min_runs = 3;
+    double max_exponent = 1.5;
+    bool check = false;
+    // what the timed phases allocate from, fresh for every run
+    MemoryResourceKind memory = MemoryResourceKind::NewDelete;
+    // whether the programs are parsed with their expressions hash-consed
+    bool hash_cons = false;
+    // instead of benchmarking, compare analyse_source_constexpr with analyse_source on the generated programs and
+    // on `files`
+    bool check_constexpr = false;
+    std::vector<std::string> files;
+};
+
+struct Measurement {
+    ProgramShape shape;
+    const char *phase;
+    size_t statements;
+    size_t bytes;
+    size_t runs;
+    double seconds;
+};
+
+struct ScalingFit {
+    ProgramShape shape;
+    const char *phase;
+    double exponent;
+    bool flagged;
+};
+
+// Runs `body` until both the minimum time and number of runs are reached, and returns the fastest run.
+static double time_phase(const BenchOptions &options, const std::function<void()> &body, size_t &runs) {
+    using clock = std::chrono::steady_clock;
+    double best = INFINITY;
+    double total = 0;
+    runs = 0;
+    while (runs < options.min_runs || total < options.min_time) {
+        const auto start = clock::now();
+        body();
+        const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        best = std::min(best, seconds);
+        total += seconds;
+        runs++;
+    }
+    return best;
+}
+
+// Reads the whole source token by token, the way the parser drives the lexer.
+static size_t lex_all(const std::string_view src) {
+    Lexer lexer{src};
+    size_t tokens = 0;
+    while (true) {
+        lexer.skip_whitespace();
+        if (lexer.eof()) {
+            break;
+        }
+        if (is_digit(lexer.peek())) {
+            lexer.read_number();
+        } else if (is_alpha(lexer.peek())) {
+            lexer.read_name();
+        } else {
+            lexer.next();
+        }
+        tokens++;
+    }
+    return tokens;
+}
+
+static void bench_program(const BenchOptions &options, const ProgramShape shape, const size_t statements,
+                          std::vector<Measurement> &measurements) {
+    const std::string src = generate_program(shape, statements, options.seed);
+
+    // every phase gets the output of the previous ones, computed outside of the timed region
+    ExprInterner interner;
+    ParserState state{Lexer{src}, std::pmr::get_default_resource(), options.hash_cons ? &interner : nullptr};
+    const Program program = parse_program(state);
+    Cfg cfg = build_cfg(program);
+    ConstantState constants;
+    fold_constant_branches(cfg, constants);
+    const Dfg dfg = build_dfg(cfg);
+    DfgNodeOutputs outputs;
+    compute_whole_program_required_outputs(program, outputs);
+
+    volatile size_t sink = 0;
+    const auto measure = [&](const char *phase, const std::function<void()> &body) {
+        Measurement m{shape, phase, statements, src.size(), 0, 0};
+        m.seconds = time_phase(options, body, m.runs);
+        measurements.push_back(m);
+    };
+
+    measure("lex", [&] {
+        sink = sink + lex_all(src);
+    });
+    measure("line_index", [&] {
+        sink = sink + LineIndex::build(src).line_starts.size();
+    });
+    measure("parse_program", [&] {
+        const PhaseMemoryResources memory{options.memory};
+        ExprInterner run_interner;
+        ParserState s{Lexer{src}, memory.phases().parse, options.hash_cons ? &run_interner : nullptr};
+        sink = sink + parse_program(s).statements.statements.size();
+    });
+    measure("build_cfg", [&] {
+        const PhaseMemoryResources memory{options.memory};
+        sink = sink + (build_cfg(program, memory.phases().cfg).entry != nullptr);
+    });
+    // idempotent, so it can run over the same CFG again and again
+    measure("fold_branches", [&] {
+        ConstantState entry;
+        sink = sink + fold_constant_branches(cfg, entry);
+    });
+    measure("build_dfg", [&] {
+        const PhaseMemoryResources memory{options.memory};
+        sink = sink + build_dfg(cfg, memory.phases().dfg).nodes.size();
+    });
+    // a pure AST traversal, the visitor dispatch and little else
+    measure("required_outputs", [&] {
+        DfgNodeOutputs required;
+        compute_whole_program_required_outputs(program, required);
+        sink = sink + required.out.size();
+    });
+    measure("analyse_dfg", [&] {
+        const PhaseMemoryResources memory{options.memory};
+        DfgNodeUnusedAssignments unused;
+        analyse_dfg(dfg, outputs, unused, memory.phases().analysis);
+        sink = sink + unused.assignments.size();
+    });
+    measure("analyse_source", [&] {
+        const PhaseMemoryResources memory{options.memory};
+        sink = sink + analyse_source(src, memory.phases(), options.hash_cons).size();
+    });
+}
+
+// The results of an analysis, or the message of the error it stopped with.
+struct CheckedResults {
+    std::vector<UnusedAssignment> results;
+    std::string error;
+};
+
+// Runs analyse_source_constexpr outside of constant evaluation, with room for the few thousand unused assignments
+// the generated programs report; more is an error, reported like any other.
+static CheckedResults run_constexpr_analysis(const std::string_view src) {
+    CheckedResults checked;
+    try {
+        const auto report = analyse_source_constexpr<1 << 14>(src);
+        checked.results.assign(report.begin(), report.end());
+    } catch (const std::runtime_error &e) {
+        checked.error = e.what();
+    }
+    return checked;
+}
+
+static CheckedResults run_analysis(const std::string_view src) {
+    CheckedResults checked;
+    try {
+        checked.results = analyse_source(src);
+    } catch (const std::runtime_error &e) {
+        checked.error = e.what();
+    }
+    return checked;
+}
+
+// Compares the two pipelines on `src`, printing the first difference. Returns whether they agree.
+static bool check_constexpr_analysis(const std::string &name, const std::string_view src) {
+    const CheckedResults expected = run_analysis(src);
+    const CheckedResults actual = run_constexpr_analysis(src);
+    if (expected.error != actual.error) {
+        std::cerr << "check-constexpr: " << name << ": analyse_source "
+                  << (expected.error.empty() ? "succeeds" : "fails with '" + expected.error + "'")
+                  << ", analyse_source_constexpr "
+                  << (actual.error.empty() ? "succeeds" : "fails with '" + actual.error + "'") << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < std::max(expected.results.size(), actual.results.size()); i++) {
+        if (i < expected.results.size() && i < actual.results.size()) {
+            const UnusedAssignment &e = expected.results[i];
+            const UnusedAssignment &a = actual.results[i];
+            if (e.name == a.name && e.start == a.start && e.end == a.end && e.line == a.line
+                && e.column == a.column) {
+                continue;
+            }
+        }
+        const auto describe = [](const std::vector<UnusedAssignment> &results, const size_t index) {
+            if (index >= results.size()) {
+                return std::string{"nothing"};
+            }
+            const UnusedAssignment &r = results[index];
+            return std::string(r.name) + " at " + std::to_string(r.start) + ".." + std::to_string(r.end) + " ("
+                   + std::to_string(r.line) + ":" + std::to_string(r.column) + ")";
+        };
+        std::cerr << "check-constexpr: " << name << ": result " << i << " is " << describe(actual.results, i)
+                  << ", analyse_source has " << describe(expected.results, i) << std::endl;
+        return false;
+    }
+    std::cerr << "check-constexpr: " << name << ": " << expected.results.size() << " result(s) agree" << std::endl;
+    return true;
+}
+
+static int run_constexpr_check(const BenchOptions &options) {
+    bool all_agree = true;
+    for (const std::string &path: options.files) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "Failed to open file " << path << std::endl;
+            return 1;
+        }
+        std::stringstream contents;
+        contents << file.rdbuf();
+        all_agree &= check_constexpr_analysis(path, contents.str());
+    }
+    for (const ProgramShape shape: options.shapes) {
+        for (const size_t statements: options.sizes) {
+            const std::string name = std::string(program_shape_name(shape)) + " " + std::to_string(statements);
+            all_agree &= check_constexpr_analysis(name, generate_program(shape, statements, options.seed));
+        }
+    }
+    return all_agree ? 0 : 3;
+}
+
+// Least squares slope of log(seconds) over log(statements).
+static double fit_exponent(const std::vector<const Measurement *> &points) {
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (const Measurement *m: points) {
+        const double x = std::log(static_cast<double>(m->statements));
+        const double y = std::log(std::max(m->seconds, 1e-9));
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    const double n = static_cast<double>(points.size());
+    const double denominator = n * sxx - sx * sx;
+    return denominator == 0 ? 0 : (n * sxy - sx * sy) / denominator;
+}
+
+static std::vector<ScalingFit> fit_scaling(const BenchOptions &options,
+                                           const std::vector<Measurement> &measurements) {
+    std::vector<ScalingFit> fits;
+    for (const ProgramShape shape: options.shapes) {
+        for (const Measurement &first: measurements) {
+            if (first.shape != shape || first.statements != options.sizes.front()) {
+                continue;
+            }
+            std::vector<const Measurement *> points;
+            for (const Measurement &m: measurements) {
+                if (m.shape == shape && std::strcmp(m.phase, first.phase) == 0) {
+                    points.push_back(&m);
+                }
+            }
+            const double exponent = fit_exponent(points);
+            fits.push_back(ScalingFit{shape, first.phase, exponent, exponent > options.max_exponent});
+        }
+    }
+    return fits;
+}
+
+static void append_seconds(ReportBuffer &out, const double seconds) {
+    char digits[32];
+    const int n = std::snprintf(digits, sizeof(digits), "%.9f", seconds);
+    out.append(std::string_view{digits, static_cast<size_t>(n)});
+}
+
+static void write_json(ReportBuffer &out, const BenchOptions &options, const std::vector<Measurement> &measurements,
+                       const std::vector<ScalingFit> &fits) {
+    out.append("{\"seed\":");
+    out.append_number(options.seed);
+    out.append(",\"memory_resource\":");
+    out.append_json_string(options.memory == MemoryResourceKind::NewDelete ? "new"
+                           : options.memory == MemoryResourceKind::Pool ? "pool" : "monotonic");
+    out.append(",\"hash_cons\":");
+    out.append(options.hash_cons ? "true" : "false");
+    out.append(",\"max_exponent\":");
+    append_seconds(out, options.max_exponent);
+    out.append(",\"measurements\":[");
+    for (size_t i = 0; i < measurements.size(); i++) {
+        const Measurement &m = measurements[i];
+        out.append(i == 0 ? "\n" : ",\n");
+        out.append("{\"shape\":");
+        out.append_json_string(program_shape_name(m.shape));
+        out.append(",\"phase\":");
+        out.append_json_string(m.phase);
+        out.append(",\"statements\":");
+        out.append_number(m.statements);
+        out.append(",\"bytes\":");
+        out.append_number(m.bytes);
+        out.append(",\"runs\":");
+        out.append_number(m.runs);
+        out.append(",\"seconds\":");
+        append_seconds(out, m.seconds);
+        out.append(",\"mb_per_second\":");
+        append_seconds(out, static_cast<double>(m.bytes) / 1e6 / std::max(m.seconds, 1e-12));
+        out.append('}');
+    }
+    out.append("],\"scaling\":[");
+    for (size_t i = 0; i < fits.size(); i++) {
+        const ScalingFit &fit = fits[i];
+        out.append(i == 0 ? "\n" : ",\n");
+        out.append("{\"shape\":");
+        out.append_json_string(program_shape_name(fit.shape));
+        out.append(",\"phase\":");
+        out.append_json_string(fit.phase);
+        out.append(",\"exponent\":");
+        append_seconds(out, fit.exponent);
+        out.append(",\"flagged\":");
+        out.append(fit.flagged ? "true" : "false");
+        out.append('}');
+    }
+    out.append("]}\n");
+}
+
+static bool parse_sizes(const std::string &arg, std::vector<size_t> &sizes) {
+    sizes.clear();
+    size_t pos = 0;
+    while (pos <= arg.size()) {
+        const size_t comma = std::min(arg.find(',', pos), arg.size());
+        try {
+            sizes.push_back(std::stoul(arg.substr(pos, comma - pos)));
+        } catch (const std::exception &) {
+            return false;
+        }
+        pos = comma + 1;
+    }
+    return sizes.size() >= 2 && std::ranges::is_sorted(sizes) && sizes.front() > 0;
+}
+
+static bool parse_shape(const std::string &name, ProgramShape &shape) {
+    for (const ProgramShape s: all_program_shapes) {
+        if (name == program_shape_name(s)) {
+            shape = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int usage() {
+    std::cerr << "Usage: dfa_bench [--seed N] [--sizes N,N,...] [--shape NAME]... [--min-time SECONDS]"
+                 " [--max-exponent X] [--memory-resource new|pool|monotonic] [--hash-cons] [--check]\n"
+                 "       dfa_bench --check-constexpr [--seed N] [--sizes N,N,...] [--shape NAME]... [FILE]..."
+              << std::endl;
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    BenchOptions options;
+    bool shapes_given = false;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        try {
+            if (arg == "--seed" && has_value) {
+                options.seed = std::stoull(argv[++i]);
+            } else if (arg == "--sizes" && has_value) {
+                if (!parse_sizes(argv[++i], options.sizes)) {
+                    std::cerr << "--sizes needs at least two increasing sizes" << std::endl;
+                    return 1;
+                }
+            } else if (arg == "--shape" && has_value) {
+                ProgramShape shape;
+                if (!parse_shape(argv[++i], shape)) {
+                    std::cerr << "Unknown shape " << argv[i] << std::endl;
+                    return 1;
+                }
+                if (!shapes_given) {
+                    options.shapes.clear();
+                    shapes_given = true;
+                }
+                options.shapes.push_back(shape);
+            } else if (arg == "--min-time" && has_value) {
+                options.min_time = std::stod(argv[++i]);
+            } else if (arg == "--max-exponent" && has_value) {
+                options.max_exponent = std::stod(argv[++i]);
+            } else if (arg == "--memory-resource" && has_value) {
+                if (!parse_memory_resource_kind(argv[++i], options.memory)) {
+                    std::cerr << "Unknown memory resource " << argv[i] << std::endl;
+                    return 1;
+                }
+            } else if (arg == "--hash-cons") {
+                options.hash_cons = true;
+            } else if (arg == "--check") {
+                options.check = true;
+            } else if (arg == "--check-constexpr") {
+                options.check_constexpr = true;
+            } else if (options.check_constexpr && !arg.starts_with("--")) {
+                options.files.push_back(arg);
+            } else {
+                return usage();
+            }
+        } catch (const std::exception &) {
+            return usage();
+        }
+    }
+
+    if (options.check_constexpr) {
+        return run_constexpr_check(options);
+    }
+
+    std::vector<Measurement> measurements;
+    for (const ProgramShape shape: options.shapes) {
+        for (const size_t statements: options.sizes) {
+            std::cerr << "bench: " << program_shape_name(shape) << " " << statements << std::endl;
+            bench_program(options, shape, statements, measurements);
+        }
+    }
+    const std::vector<ScalingFit> fits = fit_scaling(options, measurements);
+
+    {
+        ReportBuffer out{STDOUT_FILENO};
+        write_json(out, options, measurements, fits);
+    }
+
+    bool any_flagged = false;
+    for (const ScalingFit &fit: fits) {
+        if (fit.flagged) {
+            std::cerr << "bench: " << fit.phase << " on " << program_shape_name(fit.shape) << " scales as n^"
+                      << fit.exponent << std::endl;
+            any_flagged = true;
+        }
+    }
+    return options.check && any_flagged ? 2 : 0;
+}
@@ -0,0 +1,63 @@
+#ifndef DFA_SAMPLE_BOUNDED_QUEUE_HPP
+#define DFA_SAMPLE_BOUNDED_QUEUE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+// A FIFO shared between pipeline stages. Producers block while it holds `capacity` items, which is what pushes
+// back on a stage that runs ahead of the next one. It closes once all of its `producers` have called
+// producer_done, after which pop drains the remaining items and then returns nothing.
+template<typename T>
+class BoundedQueue {
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<T> items;
+    size_t capacity;
+    size_t producers;
+
+public:
+    // sum of the queue sizes seen by pushes, and how many pushes had to wait for room
+    size_t pushes = 0;
+    size_t size_sum = 0;
+    size_t full_pushes = 0;
+
+    BoundedQueue(const size_t capacity, const size_t producers)
+        : capacity(capacity == 0 ? 1 : capacity), producers(producers) {
+    }
+
+    void push(T item) {
+        std::unique_lock lock{mutex};
+        if (items.size() >= capacity) {
+            full_pushes++;
+            not_full.wait(lock, [&] { return items.size() < capacity; });
+        }
+        pushes++;
+        size_sum += items.size();
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+    }
+
+    std::optional<T> pop() {
+        std::unique_lock lock{mutex};
+        not_empty.wait(lock, [&] { return !items.empty() || producers == 0; });
+        if (items.empty()) {
+            return std::nullopt;
+        }
+        T item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return item;
+    }
+
+    void producer_done() {
+        std::lock_guard lock{mutex};
+        if (--producers == 0) {
+            not_empty.notify_all();
+        }
+    }
+};
+
+#endif //DFA_SAMPLE_BOUNDED_QUEUE_HPP
@@ -0,0 +1,418 @@
+#include "bytecode.hpp"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include "flat_expr.hpp"
+#include "trace.hpp"
+#include "visitor.hpp"
+
+// Threads the interpreter with GCC's labels as values where the compiler has them: every handler jumps
+// straight to the next one, instead of going back to a shared switch.
+#ifndef DFA_COMPUTED_GOTO
+#if defined(__GNUC__)
+#define DFA_COMPUTED_GOTO 1
+#else
+#define DFA_COMPUTED_GOTO 0
+#endif
+#endif
+
+struct VariableCollector : public StaticAstVisitor<VariableCollector> {
+    std::vector<std::string> variables;
+    std::unordered_set<std::string_view> seen;
+
+    void add(const std::string_view name) {
+        if (seen.insert(name).second) {
+            variables.emplace_back(name);
+        }
+    }
+
+    void visit_name(const Name &name) {
+        add(name.name);
+    }
+
+    void visit_assignment_stmt(const AssignmentStmt &assignment_stmt) {
+        add(assignment_stmt.lhs.name);
+        walk_assignment_stmt(assignment_stmt);
+    }
+};
+
+static Opcode register_opcode(const BinaryOp op) {
+    static constexpr Opcode opcodes[] = {Opcode::Add, Opcode::Sub, Opcode::Mul, Opcode::Div, Opcode::Lt, Opcode::Gt};
+    return opcodes[op];
+}
+
+static Opcode immediate_opcode(const BinaryOp op) {
+    static constexpr Opcode opcodes[] = {
+        Opcode::AddImm, Opcode::SubImm, Opcode::MulImm, Opcode::DivImm, Opcode::LtImm, Opcode::GtImm,
+    };
+    return opcodes[op];
+}
+
+static const Expr &strip_parens(const Expr &expr) {
+    const Expr *e = &expr;
+    while (const auto *paren = std::get_if<ParenExpr>(&e->data)) {
+        e = paren->expr.get();
+    }
+    return *e;
+}
+
+class BytecodeCompiler {
+    BytecodeProgram program;
+    std::unordered_map<std::string_view, uint16_t> variables;
+    // intermediate results in use, in the registers after the variables
+    size_t temporaries = 0;
+
+    // A register, or a constant that has not been put in one.
+    struct Operand {
+        std::optional<int32_t> constant = std::nullopt;
+        uint16_t reg = 0;
+    };
+
+    size_t emit(const Instruction &instruction) {
+        program.code.push_back(instruction);
+        return program.code.size() - 1;
+    }
+
+    uint16_t allocate_temporary() {
+        const size_t reg = program.variables.size() + temporaries++;
+        if (reg > std::numeric_limits<uint16_t>::max()) {
+            throw std::runtime_error("Expression too deep");
+        }
+        program.registers = std::max(program.registers, reg + 1);
+        return static_cast<uint16_t>(reg);
+    }
+
+    Operand compile_operand(const Expr &expr) {
+        const Expr &e = strip_parens(expr);
+        if (const auto *name = std::get_if<Name>(&e.data)) {
+            return Operand{.reg = variables.at(name->name)};
+        }
+        if (const auto *constant = std::get_if<Constant>(&e.data)) {
+            return Operand{.constant = constant->value};
+        }
+        return compile_binary(std::get<BinaryExpr>(e.data), std::nullopt);
+    }
+
+    uint16_t in_register(const Operand &operand) {
+        if (!operand.constant) {
+            return operand.reg;
+        }
+        const uint16_t reg = allocate_temporary();
+        emit(Instruction{.op = Opcode::LoadConst, .dst = reg, .imm = *operand.constant});
+        return reg;
+    }
+
+    // Leaves the value of `expr` in `dst`, writing it only with the last instruction, so that `expr` may read
+    // the variable it is assigned to.
+    void compile_into(const Expr &expr, const uint16_t dst) {
+        const Expr &e = strip_parens(expr);
+        std::visit([&]<typename T0>(T0 &&node) {
+            using T = std::decay_t<T0>;
+            if constexpr (std::is_same_v<T, Name>) {
+                const uint16_t src = variables.at(node.name);
+                if (src != dst) {
+                    emit(Instruction{.op = Opcode::Move, .dst = dst, .a = src});
+                }
+            } else if constexpr (std::is_same_v<T, Constant>) {
+                emit(Instruction{.op = Opcode::LoadConst, .dst = dst, .imm = node.value});
+            } else if constexpr (std::is_same_v<T, ParenExpr>) {
+                compile_into(*node.expr, dst);
+            } else if constexpr (std::is_same_v<T, BinaryExpr>) {
+                const Operand result = compile_binary(node, dst);
+                if (result.constant) {
+                    emit(Instruction{.op = Opcode::LoadConst, .dst = dst, .imm = *result.constant});
+                }
+            } else {
+                static_assert(false, "non-exhaustive visitor!");
+            }
+        }, e.data);
+    }
+
+    // Computes `binary` into `dst`, or into a new temporary without one. Constant operands are folded, and the
+    // result is then returned as a constant instead.
+    Operand compile_binary(const BinaryExpr &binary, const std::optional<uint16_t> dst) {
+        const size_t mark = temporaries;
+        Operand lhs = compile_operand(*binary.lhs);
+        Operand rhs = compile_operand(*binary.rhs);
+        BinaryOp op = binary.op;
+        if (lhs.constant && rhs.constant && !(op == Div && *rhs.constant == 0)) {
+            temporaries = mark;
+            return Operand{.constant = apply_binary_op(flat_op_kind(op), *lhs.constant, *rhs.constant)};
+        }
+        // only the right operand can be an immediate
+        if (lhs.constant && !rhs.constant && op != Sub && op != Div) {
+            std::swap(lhs, rhs);
+            op = op == Lt ? Gt : op == Gt ? Lt : op;
+        }
+        const uint16_t a = in_register(lhs);
+        // the operands are read by the same instruction that writes the result, so it may reuse their registers
+        temporaries = mark;
+        const uint16_t result = dst ? *dst : allocate_temporary();
+        if (rhs.constant) {
+            emit(Instruction{.op = immediate_opcode(op), .dst = result, .a = a, .imm = *rhs.constant});
+        } else {
+            emit(Instruction{.op = register_opcode(op), .dst = result, .a = a, .b = rhs.reg});
+        }
+        return Operand{.reg = result};
+    }
+
+    // Jumps when `condition` is or is not 0, as `when_true` says, to the instructions added to `patches`; a
+    // constant condition gives a plain jump or nothing.
+    void compile_branch(const Expr &condition, const bool when_true, std::vector<size_t> &patches) {
+        const size_t mark = temporaries;
+        const Expr &e = strip_parens(condition);
+        const auto *binary = std::get_if<BinaryExpr>(&e.data);
+        if (binary != nullptr && (binary->op == Lt || binary->op == Gt)) {
+            Operand lhs = compile_operand(*binary->lhs);
+            Operand rhs = compile_operand(*binary->rhs);
+            bool less = binary->op == Lt;
+            if (lhs.constant && rhs.constant) {
+                const bool holds = less ? *lhs.constant < *rhs.constant : *lhs.constant > *rhs.constant;
+                if (holds == when_true) {
+                    patches.push_back(emit(Instruction{.op = Opcode::Jump}));
+                }
+            } else {
+                if (lhs.constant) {
+                    std::swap(lhs, rhs);
+                    less = !less;
+                }
+                // a jump when the comparison does not hold jumps on the opposite one
+                static constexpr Opcode register_jumps[2][2] = {
+                    {Opcode::JumpIfLe, Opcode::JumpIfGt}, {Opcode::JumpIfGe, Opcode::JumpIfLt},
+                };
+                static constexpr Opcode immediate_jumps[2][2] = {
+                    {Opcode::JumpIfLeImm, Opcode::JumpIfGtImm}, {Opcode::JumpIfGeImm, Opcode::JumpIfLtImm},
+                };
+                if (rhs.constant) {
+                    patches.push_back(emit(Instruction{
+                        .op = immediate_jumps[less][when_true], .a = lhs.reg, .imm = *rhs.constant,
+                    }));
+                } else {
+                    patches.push_back(emit(Instruction{
+                        .op = register_jumps[less][when_true], .a = lhs.reg, .b = rhs.reg,
+                    }));
+                }
+            }
+            temporaries = mark;
+            return;
+        }
+        const Operand value = compile_operand(e);
+        if (value.constant) {
+            if ((*value.constant != 0) == when_true) {
+                patches.push_back(emit(Instruction{.op = Opcode::Jump}));
+            }
+        } else {
+            patches.push_back(emit(Instruction{
+                .op = when_true ? Opcode::JumpIfNotZero : Opcode::JumpIfZero, .a = value.reg,
+            }));
+        }
+        temporaries = mark;
+    }
+
+    void patch(const std::vector<size_t> &patches, const size_t target) {
+        for (const size_t index: patches) {
+            program.code[index].target = static_cast<uint32_t>(target);
+        }
+    }
+
+    void compile_statements(const StmtList &stmt_list) {
+        for (const Stmt &stmt: stmt_list.statements) {
+            std::visit([&]<typename T0>(T0 &&node) {
+                using T = std::decay_t<T0>;
+                if constexpr (std::is_same_v<T, AssignmentStmt>) {
+                    compile_into(*node.rhs, variables.at(node.lhs.name));
+                } else if constexpr (std::is_same_v<T, IfStmt>) {
+                    std::vector<size_t> skip;
+                    compile_branch(*node.condition, false, skip);
+                    compile_statements(*node.then_block);
+                    patch(skip, program.code.size());
+                } else if constexpr (std::is_same_v<T, WhileStmt>) {
+                    // the test goes after the body, so that every iteration takes a single jump
+                    const size_t to_test = emit(Instruction{.op = Opcode::Jump});
+                    const size_t body = program.code.size();
+                    compile_statements(*node.body);
+                    program.code[to_test].target = static_cast<uint32_t>(program.code.size());
+                    std::vector<size_t> repeat;
+                    compile_branch(*node.condition, true, repeat);
+                    patch(repeat, body);
+                } else {
+                    static_assert(false, "non-exhaustive visitor!");
+                }
+            }, stmt.data);
+        }
+    }
+
+public:
+    BytecodeProgram compile(const Program &source) {
+        program.variables = program_variables(source);
+        if (program.variables.size() > std::numeric_limits<uint16_t>::max()) {
+            throw std::runtime_error("Too many variables");
+        }
+        for (size_t i = 0; i < program.variables.size(); i++) {
+            variables.emplace(program.variables[i], static_cast<uint16_t>(i));
+        }
+        program.registers = program.variables.size();
+        compile_statements(source.statements);
+        emit(Instruction{.op = Opcode::Halt});
+        return std::move(program);
+    }
+};
+
+std::vector<std::string> program_variables(const Program &program) {
+    VariableCollector collector;
+    collector.visit_program(program);
+    return std::move(collector.variables);
+}
+
+BytecodeProgram compile_bytecode(const Program &program) {
+    TraceScope trace{"compile_bytecode"};
+    return BytecodeCompiler{}.compile(program);
+}
+
+static int32_t wrapping_add(const int32_t lhs, const int32_t rhs) {
+    return static_cast<int32_t>(static_cast<uint32_t>(lhs) + static_cast<uint32_t>(rhs));
+}
+
+static int32_t wrapping_sub(const int32_t lhs, const int32_t rhs) {
+    return static_cast<int32_t>(static_cast<uint32_t>(lhs) - static_cast<uint32_t>(rhs));
+}
+
+static int32_t wrapping_mul(const int32_t lhs, const int32_t rhs) {
+    return static_cast<int32_t>(static_cast<uint32_t>(lhs) * static_cast<uint32_t>(rhs));
+}
+
+static int32_t checked_div(const int32_t lhs, const int32_t rhs) {
+    if (rhs == 0) {
+        throw std::runtime_error("Division by zero");
+    }
+    // the one quotient that does not fit
+    if (lhs == std::numeric_limits<int32_t>::min() && rhs == -1) {
+        return lhs;
+    }
+    return lhs / rhs;
+}
+
+ExecutionResult run_bytecode(const BytecodeProgram &program, const std::vector<int32_t> &initial,
+                             const uint64_t max_instructions) {
+    TraceScope trace{"run_bytecode"};
+    std::vector<int32_t> registers(program.registers, 0);
+    std::copy_n(initial.begin(), std::min(initial.size(), program.variables.size()), registers.begin());
+    int32_t *const r = registers.data();
+    const Instruction *const code = program.code.data();
+    const Instruction *pc = code;
+    uint64_t executed = 0;
+
+    // Each handler ends in DISPATCH, which counts the next instruction and runs it.
+#if DFA_COMPUTED_GOTO
+    static void *const dispatch_table[] = {
+        &&op_LoadConst, &&op_Move,
+        &&op_Add, &&op_Sub, &&op_Mul, &&op_Div, &&op_Lt, &&op_Gt,
+        &&op_AddImm, &&op_SubImm, &&op_MulImm, &&op_DivImm, &&op_LtImm, &&op_GtImm,
+        &&op_Jump, &&op_JumpIfZero, &&op_JumpIfNotZero,
+        &&op_JumpIfLt, &&op_JumpIfGe, &&op_JumpIfGt, &&op_JumpIfLe,
+        &&op_JumpIfLtImm, &&op_JumpIfGeImm, &&op_JumpIfGtImm, &&op_JumpIfLeImm,
+        &&op_Halt,
+    };
+    static_assert(std::size(dispatch_table) == static_cast<size_t>(Opcode::Halt) + 1);
+#define HANDLER(name) op_##name
+#define DISPATCH() do { ++executed; goto *dispatch_table[static_cast<uint8_t>(pc->op)]; } while (false)
+    DISPATCH();
+#else
+#define HANDLER(name) case Opcode::name
+#define DISPATCH() { ++executed; continue; }
+    ++executed;
+    for (;;) {
+        switch (pc->op) {
+#endif
+
+#define BINARY_HANDLER(name, rhs, f) \
+    HANDLER(name): \
+        r[pc->dst] = f(r[pc->a], rhs); \
+        ++pc; \
+        DISPATCH();
+#define JUMP_HANDLER(name, condition) \
+    HANDLER(name): \
+        if (condition) { \
+            pc = code + pc->target; \
+            if (executed > max_instructions) { \
+                throw std::runtime_error("Instruction limit exceeded"); \
+            } \
+        } else { \
+            ++pc; \
+        } \
+        DISPATCH();
+
+    HANDLER(LoadConst):
+        r[pc->dst] = pc->imm;
+        ++pc;
+        DISPATCH();
+    HANDLER(Move):
+        r[pc->dst] = r[pc->a];
+        ++pc;
+        DISPATCH();
+    BINARY_HANDLER(Add, r[pc->b], wrapping_add)
+    BINARY_HANDLER(Sub, r[pc->b], wrapping_sub)
+    BINARY_HANDLER(Mul, r[pc->b], wrapping_mul)
+    BINARY_HANDLER(Div, r[pc->b], checked_div)
+    BINARY_HANDLER(Lt, r[pc->b], std::less<int32_t>{})
+    BINARY_HANDLER(Gt, r[pc->b], std::greater<int32_t>{})
+    BINARY_HANDLER(AddImm, pc->imm, wrapping_add)
+    BINARY_HANDLER(SubImm, pc->imm, wrapping_sub)
+    BINARY_HANDLER(MulImm, pc->imm, wrapping_mul)
+    BINARY_HANDLER(DivImm, pc->imm, checked_div)
+    BINARY_HANDLER(LtImm, pc->imm, std::less<int32_t>{})
+    BINARY_HANDLER(GtImm, pc->imm, std::greater<int32_t>{})
+    JUMP_HANDLER(Jump, true)
+    JUMP_HANDLER(JumpIfZero, r[pc->a] == 0)
+    JUMP_HANDLER(JumpIfNotZero, r[pc->a] != 0)
+    JUMP_HANDLER(JumpIfLt, r[pc->a] < r[pc->b])
+    JUMP_HANDLER(JumpIfGe, r[pc->a] >= r[pc->b])
+    JUMP_HANDLER(JumpIfGt, r[pc->a] > r[pc->b])
+    JUMP_HANDLER(JumpIfLe, r[pc->a] <= r[pc->b])
+    JUMP_HANDLER(JumpIfLtImm, r[pc->a] < pc->imm)
+    JUMP_HANDLER(JumpIfGeImm, r[pc->a] >= pc->imm)
+    JUMP_HANDLER(JumpIfGtImm, r[pc->a] > pc->imm)
+    JUMP_HANDLER(JumpIfLeImm, r[pc->a] <= pc->imm)
+    HANDLER(Halt):
+        registers.resize(program.variables.size());
+        return ExecutionResult{.values = std::move(registers), .instructions = executed};
+
+#if !DFA_COMPUTED_GOTO
+        }
+    }
+#endif
+#undef JUMP_HANDLER
+#undef BINARY_HANDLER
+#undef DISPATCH
+#undef HANDLER
+}
+
+static const char *opcode_name(const Opcode op) {
+    static constexpr const char *names[] = {
+        "LoadConst", "Move",
+        "Add", "Sub", "Mul", "Div", "Lt", "Gt",
+        "AddImm", "SubImm", "MulImm", "DivImm", "LtImm", "GtImm",
+        "Jump", "JumpIfZero", "JumpIfNotZero",
+        "JumpIfLt", "JumpIfGe", "JumpIfGt", "JumpIfLe",
+        "JumpIfLtImm", "JumpIfGeImm", "JumpIfGtImm", "JumpIfLeImm",
+        "Halt",
+    };
+    static_assert(std::size(names) == static_cast<size_t>(Opcode::Halt) + 1);
+    return names[static_cast<size_t>(op)];
+}
+
+void dbg_bytecode(const BytecodeProgram &program) {
+    for (size_t i = 0; i < program.variables.size(); i++) {
+        std::cout << "r" << i << " = " << program.variables[i] << std::endl;
+    }
+    for (size_t i = 0; i < program.code.size(); i++) {
+        const Instruction &instruction = program.code[i];
+        std::cout << i << ": " << opcode_name(instruction.op) << " dst=r" << instruction.dst << " a=r"
+                  << instruction.a << " b=r" << instruction.b << " imm=" << instruction.imm << " target="
+                  << instruction.target << std::endl;
+    }
+}
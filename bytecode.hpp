@@ -0,0 +1,88 @@
+#ifndef DFA_SAMPLE_BYTECODE_HPP
+#define DFA_SAMPLE_BYTECODE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ast.hpp"
+
+enum class Opcode : uint8_t {
+    // r[dst] = imm
+    LoadConst,
+    // r[dst] = r[a]
+    Move,
+    // r[dst] = r[a] op r[b]
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Lt,
+    Gt,
+    // r[dst] = r[a] op imm
+    AddImm,
+    SubImm,
+    MulImm,
+    DivImm,
+    LtImm,
+    GtImm,
+    // pc = target
+    Jump,
+    // pc = target if r[a] is (not) 0
+    JumpIfZero,
+    JumpIfNotZero,
+    // pc = target if r[a] compares to r[b] like that
+    JumpIfLt,
+    JumpIfGe,
+    JumpIfGt,
+    JumpIfLe,
+    // pc = target if r[a] compares to imm like that
+    JumpIfLtImm,
+    JumpIfGeImm,
+    JumpIfGtImm,
+    JumpIfLeImm,
+    Halt,
+};
+
+struct Instruction {
+    Opcode op = Opcode::Halt;
+    uint16_t dst = 0;
+    uint16_t a = 0;
+    uint16_t b = 0;
+    // the constant of LoadConst and the Imm forms
+    int32_t imm = 0;
+    // the instruction jumps go to
+    uint32_t target = 0;
+};
+
+// Three-address code over registers. The first registers hold the variables, one per distinct name, and the
+// rest hold the intermediate results of expressions.
+struct BytecodeProgram {
+    std::vector<Instruction> code;
+    // the variable in each of the first registers, in order of first appearance
+    std::vector<std::string> variables;
+    size_t registers = 0;
+};
+
+// Every distinct name in `program`, assigned or read, in order of first appearance.
+std::vector<std::string> program_variables(const Program &program);
+
+// Loops are compiled with the test at the bottom, comparisons in conditions become conditional jumps, and
+// constant operands become immediates. Throws std::runtime_error if the program needs more than 65536 registers.
+BytecodeProgram compile_bytecode(const Program &program);
+
+struct ExecutionResult {
+    // the final value of every variable, in the order of BytecodeProgram::variables
+    std::vector<int32_t> values;
+    // including the final Halt
+    uint64_t instructions;
+};
+
+// Runs `program` with the variables starting at `initial`, in the order of BytecodeProgram::variables, or at 0
+// past its end, with the integer semantics of apply_binary_op. Throws std::runtime_error on a division by zero,
+// or once a jump finds more than `max_instructions` executed.
+ExecutionResult run_bytecode(const BytecodeProgram &program, const std::vector<int32_t> &initial = {},
+                             uint64_t max_instructions = UINT64_MAX);
+
+void dbg_bytecode(const BytecodeProgram &program);
+
+#endif //DFA_SAMPLE_BYTECODE_HPP
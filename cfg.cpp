@@ -3,15 +3,20 @@
 //
 
 #include "cfg.hpp"
+#include "trace.hpp"
 
-Cfg build_cfg(const Program& program) {
+Cfg build_cfg(const Program& program, std::pmr::memory_resource* memory) {
+    TraceScope trace{"build_cfg"};
+    FlatExprCache flat_exprs{memory};
     auto cfg_builder = CfgBuilder{
         Cfg{
-            .entry = std::make_shared<CfgNode>(CfgNode{
+            .entry = make_shared_in<CfgNode>(memory, CfgNode{
                 .node = ExitCfgNode(),
                 .next = nullptr
             })
-        }
+        },
+        memory,
+        &flat_exprs
     };
     cfg_builder.visit_program(program);
     return cfg_builder.cfg;
@@ -23,50 +28,53 @@ void print_indent(const int indent) {
     }
 }
 
+struct ExprPrinter : public StaticAstVisitor<ExprPrinter> {
+    void visit_name(const Name& name) {
+        std::cout << name.name;
+    }
+
+    void visit_constant(const Constant& constant) {
+        std::cout << constant.value;
+    }
+
+    void visit_paren_expr(const ParenExpr& paren_expr) {
+        std::cout << "(";
+        walk_paren_expr(paren_expr);
+        std::cout << ")";
+    }
+
+    void visit_binary_expr(const BinaryExpr& binary_expr) {
+        std::cout << "{(";
+        visit_expr(*binary_expr.lhs);
+        std::cout << " ";
+        switch (binary_expr.op) {
+            case BinaryOp::Add:
+                std::cout << "+";
+                break;
+            case BinaryOp::Sub:
+                std::cout << "-";
+                break;
+            case BinaryOp::Mul:
+                std::cout << "*";
+                break;
+            case BinaryOp::Div:
+                std::cout << "/";
+                break;
+            case BinaryOp::Lt:
+                std::cout << "<";
+                break;
+            case BinaryOp::Gt:
+                std::cout << ">";
+                break;
+        }
+        std::cout << " ";
+        visit_expr(*binary_expr.rhs);
+        std::cout << ")}";
+    }
+};
+
 static void dbg_expr(const Expr& expr) {
-    std::visit(
-        [&]<typename T0>(T0&& expr_data) {
-            using T = std::decay_t<T0>;
-            if constexpr (std::is_same_v<T, Name>) {
-                std::cout << expr_data.name;
-            } else if constexpr (std::is_same_v<T, Constant>) {
-                std::cout << expr_data.value;
-            } else if constexpr (std::is_same_v<T, ParenExpr>) {
-                std::cout << "(";
-                dbg_expr(*expr_data.expr);
-                std::cout << ")";
-            } else if constexpr (std::is_same_v<T, BinaryExpr>) {
-                std::cout << "{(";
-                dbg_expr(*expr_data.lhs);
-                const BinaryOp op = expr_data.op;
-                std::cout << " ";
-                switch (op) {
-                    case BinaryOp::Add:
-                        std::cout << "+";
-                        break;
-                    case BinaryOp::Sub:
-                        std::cout << "-";
-                        break;
-                    case BinaryOp::Mul:
-                        std::cout << "*";
-                        break;
-                    case BinaryOp::Div:
-                        std::cout << "/";
-                        break;
-                    case BinaryOp::Lt:
-                        std::cout << "<";
-                        break;
-                    case BinaryOp::Gt:
-                        std::cout << ">";
-                        break;
-                }
-                std::cout << " ";
-                dbg_expr(*expr_data.rhs);
-                std::cout << ")}";
-            } else {
-                static_assert(false, "non-exhaustive visitor!");
-            }
-        }, expr.data);
+    ExprPrinter{}.visit_expr(expr);
 }
 
 static void dbg_cfg_basic_block(const BasicCfgBlock& block, const int indent) {
@@ -10,7 +10,9 @@
 #include <optional>
 #include <ranges>
 #include "ast.hpp"
+#include "flat_expr.hpp"
 #include "visitor.hpp"
+#include "memory.hpp"
 
 struct CfgNode;
 
@@ -18,16 +20,31 @@ struct AssignmentCfgNode {
     Name name;
     std::shared_ptr<Expr> expr;
     Span span;
+    // `expr` in post-order, for everything that only needs its operands; shared by equal expressions if the
+    // parser hash-consed them
+    std::shared_ptr<const FlatExpr> flat;
+};
+
+// What fold_constant_branches found out about a condition; build_dfg leaves out the edges never taken.
+enum class ConstantCondition : uint8_t {
+    Unknown,
+    AlwaysTrue,
+    AlwaysFalse,
 };
 
 struct IfCfgNode {
     std::shared_ptr<Expr> condition;
     std::shared_ptr<CfgNode> then_branch;
+    std::shared_ptr<const FlatExpr> flat_condition;
+    ConstantCondition folded = ConstantCondition::Unknown;
 };
 
 struct WhileCfgNode {
     std::shared_ptr<Expr> condition;
     std::shared_ptr<CfgNode> body;
+    std::shared_ptr<const FlatExpr> flat_condition;
+    // only ever AlwaysFalse, for loops that are never entered
+    ConstantCondition folded = ConstantCondition::Unknown;
 };
 
 struct WhileRetDummyCfgNode {
@@ -56,37 +73,42 @@ struct Cfg {
     std::shared_ptr<CfgNode> entry;
 };
 
-class CfgBuilder final : public AstVisitor {
+class CfgBuilder final : public StaticAstVisitor<CfgBuilder> {
     Cfg cfg;
     bool allow_direct_basic_link = true;
+    std::pmr::memory_resource* memory;
+    FlatExprCache* flat_exprs;
 
 private:
-    explicit CfgBuilder(Cfg cfg) : cfg(std::move(cfg)) {
+    CfgBuilder(Cfg cfg, std::pmr::memory_resource* memory, FlatExprCache* flat_exprs)
+        : cfg(std::move(cfg)), memory(memory), flat_exprs(flat_exprs) {
     };
 
-    friend Cfg build_cfg(const Program& program);
+    friend Cfg build_cfg(const Program& program, std::pmr::memory_resource* memory);
 
 public:
-    void visit_assignment_stmt(const AssignmentStmt& assignment_stmt) override {
+    void visit_assignment_stmt(const AssignmentStmt& assignment_stmt) {
         std::visit([&]<typename T0>(T0&& node) {
             using T = std::decay_t<T0>;
             if constexpr (std::is_same_v<T, BasicCfgBlock>) {
                 if (allow_direct_basic_link) {
                     node.assignments.insert(node.assignments.begin(),
-                                            std::make_shared<AssignmentCfgNode>(AssignmentCfgNode{
+                                            make_shared_in<AssignmentCfgNode>(memory, AssignmentCfgNode{
                                                 .name = assignment_stmt.lhs,
                                                 .expr = assignment_stmt.rhs,
                                                 .span = assignment_stmt.span,
+                                                .flat = flat_exprs->lower(assignment_stmt.rhs),
                                             }));
                 } else {
                     allow_direct_basic_link = true;
-                    cfg.entry = std::make_shared<CfgNode>(CfgNode{
+                    cfg.entry = make_shared_in<CfgNode>(memory, CfgNode{
                         .node = BasicCfgBlock{
                             .assignments = {
-                                std::make_shared<AssignmentCfgNode>(AssignmentCfgNode{
+                                make_shared_in<AssignmentCfgNode>(memory, AssignmentCfgNode{
                                     .name = assignment_stmt.lhs,
                                     .expr = assignment_stmt.rhs,
                                     .span = assignment_stmt.span,
+                                    .flat = flat_exprs->lower(assignment_stmt.rhs),
                                 })
                             }
                         },
@@ -94,13 +116,14 @@ public:
                     });
                 }
             } else {
-                cfg.entry = std::make_shared<CfgNode>(CfgNode{
+                cfg.entry = make_shared_in<CfgNode>(memory, CfgNode{
                     .node = BasicCfgBlock{
                         .assignments = {
-                            std::make_shared<AssignmentCfgNode>(AssignmentCfgNode{
+                            make_shared_in<AssignmentCfgNode>(memory, AssignmentCfgNode{
                                 .name = assignment_stmt.lhs,
                                 .expr = assignment_stmt.rhs,
                                 .span = assignment_stmt.span,
+                                .flat = flat_exprs->lower(assignment_stmt.rhs),
                             })
                         }
                     },
@@ -110,30 +133,33 @@ public:
         }, cfg.entry->node);
     }
 
-    void visit_if_stmt(const IfStmt& if_stmt) override {
+    void visit_if_stmt(const IfStmt& if_stmt) {
         auto inner_cfg_builder = CfgBuilder{
             Cfg{
                 .entry = cfg.entry,
-            }
+            },
+            memory,
+            flat_exprs
         };
         inner_cfg_builder.allow_direct_basic_link = false;
         inner_cfg_builder.visit_stmt_list(*if_stmt.then_block);
-        cfg.entry = std::make_shared<CfgNode>(
+        cfg.entry = make_shared_in<CfgNode>(memory, 
             CfgNode{
                 .node = IfCfgNode{
                     .condition = if_stmt.condition,
                     .then_branch = inner_cfg_builder.cfg.entry,
+                    .flat_condition = flat_exprs->lower(if_stmt.condition),
                 },
                 .next = cfg.entry
             }
         );
     }
 
-    void visit_while_stmt(const WhileStmt& while_stmt) override {
+    void visit_while_stmt(const WhileStmt& while_stmt) {
         const std::shared_ptr<CfgNode> after_while = cfg.entry;
         std::shared_ptr<WhileRetDummyCfgNode> dummy_ret;
-        cfg.entry = std::make_shared<CfgNode>(CfgNode{
-            .node = dummy_ret = std::make_shared<WhileRetDummyCfgNode>(WhileRetDummyCfgNode{
+        cfg.entry = make_shared_in<CfgNode>(memory, CfgNode{
+            .node = dummy_ret = make_shared_in<WhileRetDummyCfgNode>(memory, WhileRetDummyCfgNode{
                         .while_node = std::optional<std::weak_ptr<CfgNode>>(),
                     }),
             .next = cfg.entry
@@ -141,14 +167,17 @@ public:
         auto inner_cfg_builder = CfgBuilder{
             Cfg{
                 .entry = cfg.entry,
-            }
+            },
+            memory,
+            flat_exprs
         };
         inner_cfg_builder.visit_stmt_list(*while_stmt.body);
-        auto while_node = std::make_shared<WhileCfgNode>(WhileCfgNode{
+        auto while_node = make_shared_in<WhileCfgNode>(memory, WhileCfgNode{
             .condition = while_stmt.condition,
             .body = inner_cfg_builder.cfg.entry,
+            .flat_condition = flat_exprs->lower(while_stmt.condition),
         });
-        cfg.entry = std::make_shared<CfgNode>(
+        cfg.entry = make_shared_in<CfgNode>(memory, 
             CfgNode{
                 .node = while_node,
                 .next = after_while,
@@ -157,14 +186,15 @@ public:
         dummy_ret->while_node = cfg.entry;
     }
 
-    void visit_stmt_list(const StmtList& stmt_list) override {
+    void visit_stmt_list(const StmtList& stmt_list) {
         for (const auto& stmt: std::ranges::reverse_view(stmt_list.statements)) {
             this->visit_statement(stmt);
         }
     }
 };
 
-Cfg build_cfg(const Program& program);
+// The nodes are allocated from `memory`.
+Cfg build_cfg(const Program& program, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
 
 void dbg_cfg(const Cfg& cfg);
 
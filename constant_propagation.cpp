@@ -0,0 +1,131 @@
+#include "constant_propagation.hpp"
+#include <optional>
+#include <set>
+#include "trace.hpp"
+
+// Keeps the constants `state` agrees on with `other`, for where two paths meet.
+static void join_constants(ConstantState &state, const ConstantState &other) {
+    std::erase_if(state.values, [&](const auto &entry) {
+        const auto it = other.values.find(entry.first);
+        return it == other.values.end() || it->second != entry.second;
+    });
+}
+
+static bool ends_chain(const std::shared_ptr<CfgNode> &node, const CfgNode *until) {
+    // the chain of a loop body ends at the loop's end node, the first one met at its level
+    return node == nullptr || node.get() == until
+           || std::holds_alternative<std::shared_ptr<WhileRetDummyCfgNode>>(node->node);
+}
+
+// Adds the names assigned from `node` to the end of its chain, in nested statements too.
+static void collect_assigned_names(std::shared_ptr<CfgNode> node, const CfgNode *until, std::set<char> &names) {
+    for (; !ends_chain(node, until); node = node->next) {
+        std::visit([&]<typename T0>(T0 &&data) {
+            using T = std::decay_t<T0>;
+            if constexpr (std::is_same_v<T, BasicCfgBlock>) {
+                for (const auto &assignment: data.assignments) {
+                    names.insert(assignment->name.name[0]);
+                }
+            } else if constexpr (std::is_same_v<T, IfCfgNode>) {
+                collect_assigned_names(data.then_branch, node->next.get(), names);
+            } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileCfgNode>>) {
+                collect_assigned_names(data->body, nullptr, names);
+            } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileRetDummyCfgNode>>
+                                 || std::is_same_v<T, ExitCfgNode>) {
+            } else {
+                static_assert(false, "non-exhaustive visitor!");
+            }
+        }, node->node);
+    }
+}
+
+// Every node is walked once: a loop body is walked with the state that holds at every test of the condition,
+// which is the state on entry without the variables the body assigns.
+class BranchFolder {
+    std::vector<int32_t> stack;
+
+public:
+    size_t folded = 0;
+
+    // Evaluates `expr` if everything it reads is known, and it does not divide by zero.
+    std::optional<int32_t> evaluate(const FlatExpr &expr, const ConstantState &state) {
+        for (const char name: expr.reads) {
+            if (!state.values.contains(name)) {
+                return std::nullopt;
+            }
+        }
+        return expr.evaluate([&](const char name) {
+            return state.values.at(name);
+        }, stack);
+    }
+
+    // Walks the chain from `node` up to `until` or the end of a loop body.
+    void walk(std::shared_ptr<CfgNode> node, const CfgNode *until, ConstantState &state) {
+        for (; !ends_chain(node, until); node = node->next) {
+            std::visit([&]<typename T0>(T0 &&data) {
+                using T = std::decay_t<T0>;
+                if constexpr (std::is_same_v<T, BasicCfgBlock>) {
+                    for (const auto &assignment: data.assignments) {
+                        const char name = assignment->name.name[0];
+                        if (const auto value = evaluate(*assignment->flat, state)) {
+                            state.values.insert_or_assign(name, *value);
+                        } else {
+                            state.values.erase(name);
+                        }
+                    }
+                } else if constexpr (std::is_same_v<T, IfCfgNode>) {
+                    walk_if(data, node->next.get(), state);
+                } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileCfgNode>>) {
+                    walk_while(*data, state);
+                } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileRetDummyCfgNode>>
+                                     || std::is_same_v<T, ExitCfgNode>) {
+                } else {
+                    static_assert(false, "non-exhaustive visitor!");
+                }
+            }, node->node);
+        }
+    }
+
+private:
+    void walk_if(IfCfgNode &if_node, const CfgNode *after, ConstantState &state) {
+        const auto condition = evaluate(*if_node.flat_condition, state);
+        if (!condition) {
+            if_node.folded = ConstantCondition::Unknown;
+            ConstantState taken = state;
+            walk(if_node.then_branch, after, taken);
+            join_constants(state, taken);
+            return;
+        }
+        folded++;
+        if (*condition != 0) {
+            if_node.folded = ConstantCondition::AlwaysTrue;
+            walk(if_node.then_branch, after, state);
+        } else {
+            if_node.folded = ConstantCondition::AlwaysFalse;
+        }
+    }
+
+    void walk_while(WhileCfgNode &while_node, ConstantState &state) {
+        const auto on_entry = evaluate(*while_node.flat_condition, state);
+        if (on_entry && *on_entry == 0) {
+            while_node.folded = ConstantCondition::AlwaysFalse;
+            folded++;
+            return;
+        }
+        while_node.folded = ConstantCondition::Unknown;
+        std::set<char> assigned;
+        collect_assigned_names(while_node.body, nullptr, assigned);
+        for (const char name: assigned) {
+            state.values.erase(name);
+        }
+        ConstantState body = state;
+        walk(while_node.body, nullptr, body);
+    }
+};
+
+size_t fold_constant_branches(Cfg &cfg, ConstantState &state) {
+    TraceScope trace{"fold_constant_branches"};
+    BranchFolder folder;
+    folder.walk(cfg.entry, nullptr, state);
+    return folder.folded;
+}
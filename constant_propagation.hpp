@@ -0,0 +1,22 @@
+#ifndef DFA_SAMPLE_CONSTANT_PROPAGATION_HPP
+#define DFA_SAMPLE_CONSTANT_PROPAGATION_HPP
+
+#include <cstdint>
+#include <map>
+#include "cfg.hpp"
+
+// The variables that hold the same value on every path to a program point, and those values.
+struct ConstantState {
+    std::map<char, int32_t> values;
+
+    bool operator==(const ConstantState &other) const = default;
+};
+
+// Propagates constants forward through `cfg`, starting from `state` and leaving the state at the exit in it, and
+// marks the if and while conditions found to always or never hold (replacing earlier marks). build_dfg leaves
+// out the edges that are never taken: the then branch of an if that never holds, the way around one that always
+// does, and the body of a loop that is never entered. A loop that is never left keeps its exit edge all the
+// same, since the analysis works backwards from the exit. Returns the number of conditions marked.
+size_t fold_constant_branches(Cfg &cfg, ConstantState &state);
+
+#endif //DFA_SAMPLE_CONSTANT_PROPAGATION_HPP
@@ -0,0 +1,41 @@
+#include "constexpr_analysis.hpp"
+
+// Checks analyse_source_constexpr against the results of the runtime pipeline on sample.aaa, at compile time. Built
+// into dfa_bench rather than dfa_core, next to its --check-constexpr over generated programs.
+
+static constexpr std::string_view sample_aaa = R"(a = 1
+b = a
+x = 3
+y = 4
+
+while (b < 5)
+  z = x
+  b = b + 1
+  x = 9
+  y = 10
+end)";
+
+static constexpr bool reports(const UnusedAssignment &result, const std::string_view name, const size_t start,
+                              const size_t end, const size_t line, const size_t column) {
+    return result.name == name && result.start == start && result.end == end && result.line == line
+           && result.column == column;
+}
+
+static constexpr auto sample_report = analyse_source_constexpr(sample_aaa);
+static_assert(sample_report.size() == 3);
+static_assert(reports(sample_report[0], "y", 18, 23, 4, 1));
+static_assert(reports(sample_report[1], "z", 41, 46, 7, 3));
+static_assert(reports(sample_report[2], "y", 69, 75, 10, 3));
+
+// a loop that is never entered, and a branch that always runs
+static constexpr auto folded_report = analyse_source_constexpr(R"(a = 0
+b = 1
+while (a)
+  b = 2
+end
+if (a < 1)
+  b = 3
+end
+)");
+static_assert(folded_report.size() == 1);
+static_assert(reports(folded_report[0], "b", 6, 11, 2, 1));
@@ -0,0 +1,693 @@
+#ifndef DFA_SAMPLE_CONSTEXPR_ANALYSIS_HPP
+#define DFA_SAMPLE_CONSTEXPR_ANALYSIS_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "analysis.hpp"
+#include "cfg.hpp"
+#include "flat_expr.hpp"
+#include "parse.hpp"
+
+// The whole pipeline of analyse_source, usable in constant expressions, for programs that are known at compile
+// time:
+//
+//     constexpr std::string_view SRC = "...";
+//     constexpr auto report = analyse_source_constexpr(SRC);
+//
+// The program is parsed by the same Lexer into arrays linked by index instead of shared_ptr trees, with the
+// expressions already flattened, and the CFG, DFG and worklist of the runtime pipeline are rebuilt the same way.
+// The arrays are std::vectors, which constant evaluation allows as long as they are gone by its end; only the
+// results are kept, in a FixedVector. They are the same as those of analyse_source, constant folding included.
+// Errors are thrown as std::runtime_error, which stops the compilation if it happens in a constant expression.
+
+// A vector with its storage inline, which can outlive a constant evaluation.
+template<typename T, size_t Capacity>
+struct FixedVector {
+    std::array<T, Capacity> items{};
+    size_t count = 0;
+
+    constexpr void push_back(const T &item) {
+        if (count == Capacity) {
+            throw std::runtime_error("FixedVector capacity exceeded");
+        }
+        items[count++] = item;
+    }
+
+    [[nodiscard]] constexpr size_t size() const {
+        return count;
+    }
+
+    [[nodiscard]] constexpr bool empty() const {
+        return count == 0;
+    }
+
+    constexpr const T &operator[](const size_t index) const {
+        return items[index];
+    }
+
+    constexpr const T *begin() const {
+        return items.data();
+    }
+
+    constexpr const T *end() const {
+        return items.data() + count;
+    }
+};
+
+// A set of variables, by their first character like everywhere in the analysis.
+struct NameSet {
+    std::array<uint64_t, 4> words{};
+
+    constexpr void insert(const char name) {
+        const auto bit = static_cast<unsigned char>(name);
+        words[bit / 64] |= uint64_t{1} << (bit % 64);
+    }
+
+    constexpr void erase(const char name) {
+        const auto bit = static_cast<unsigned char>(name);
+        words[bit / 64] &= ~(uint64_t{1} << (bit % 64));
+    }
+
+    [[nodiscard]] constexpr bool contains(const char name) const {
+        const auto bit = static_cast<unsigned char>(name);
+        return (words[bit / 64] >> (bit % 64) & 1) != 0;
+    }
+
+    constexpr NameSet &operator|=(const NameSet &other) {
+        for (size_t i = 0; i < words.size(); i++) {
+            words[i] |= other.words[i];
+        }
+        return *this;
+    }
+
+    constexpr bool operator==(const NameSet &other) const = default;
+};
+
+enum class ConstexprStmtKind : uint8_t {
+    Assignment,
+    If,
+    While,
+};
+
+struct ConstexprStmt {
+    ConstexprStmtKind kind = ConstexprStmtKind::Assignment;
+    // the assigned variable and the span of the assignment
+    Name name{};
+    Span span{};
+    // the value or the condition, ops [expr_begin, expr_end) of ConstexprProgram::ops, and the names they read
+    uint32_t expr_begin = 0;
+    uint32_t expr_end = 0;
+    NameSet reads{};
+    // the body of an if or a while, [body_begin, body_end) of ConstexprProgram::lists
+    uint32_t body_begin = 0;
+    uint32_t body_end = 0;
+};
+
+// The statements are in source order, and the statements of each list are consecutive in `lists`.
+struct ConstexprProgram {
+    std::vector<FlatOp> ops;
+    std::vector<ConstexprStmt> statements;
+    std::vector<uint32_t> lists;
+    uint32_t top_begin = 0;
+    uint32_t top_end = 0;
+};
+
+// The grammar of parse.cpp, with the same errors, and the same spans since it drives the Lexer the same way.
+class ConstexprParser {
+    Lexer lexer;
+    ConstexprProgram program;
+
+    constexpr void push_op(const FlatOpKind kind, const char name, const int32_t value) {
+        program.ops.push_back(FlatOp{.kind = kind, .name = name, .value = value});
+    }
+
+    constexpr void parse_atom() {
+        lexer.skip_whitespace();
+
+        // parse.cpp reads the terminator of the string here
+        const char c = lexer.eof() ? '\0' : lexer.peek();
+        if (c == '(') {
+            lexer.next();
+            parse_expr();
+            lexer.skip_whitespace();
+
+            if (lexer.eof()) {
+                throw std::runtime_error("Unexpected end of input");
+            }
+
+            if (lexer.next() != ')') {
+                throw std::runtime_error("Expected ')'");
+            }
+            return;
+        }
+        if (is_digit(c)) {
+            push_op(FlatOpKind::Constant, 0, lexer.read_number().value);
+            return;
+        }
+        if (is_alpha(c)) {
+            push_op(FlatOpKind::Name, lexer.read_name().name[0], 0);
+            return;
+        }
+        throw std::runtime_error("Unexpected character");
+    }
+
+    // One level of binary operators: `op1` and `op2` are its two characters, parsed into `kind1` and `kind2`.
+    template<auto ParseOperand>
+    constexpr void parse_binary(const char op1, const FlatOpKind kind1, const char op2, const FlatOpKind kind2) {
+        (this->*ParseOperand)();
+        lexer.skip_whitespace();
+
+        if (lexer.eof()) {
+            return;
+        }
+
+        char c = lexer.peek();
+        while (c == op1 || c == op2) {
+            lexer.next();
+            (this->*ParseOperand)();
+            push_op(c == op1 ? kind1 : kind2, 0, 0);
+            lexer.skip_whitespace();
+            if (lexer.eof()) {
+                break;
+            }
+            c = lexer.peek();
+        }
+    }
+
+    constexpr void parse_precedence_1() {
+        parse_binary<&ConstexprParser::parse_atom>('*', FlatOpKind::Mul, '/', FlatOpKind::Div);
+    }
+
+    constexpr void parse_precedence_2() {
+        parse_binary<&ConstexprParser::parse_precedence_1>('+', FlatOpKind::Add, '-', FlatOpKind::Sub);
+    }
+
+    constexpr void parse_precedence_3() {
+        parse_binary<&ConstexprParser::parse_precedence_2>('<', FlatOpKind::Lt, '>', FlatOpKind::Gt);
+    }
+
+    constexpr void parse_expr() {
+        lexer.skip_whitespace();
+
+        if (lexer.eof()) {
+            throw std::runtime_error("Unexpected end of input");
+        }
+
+        parse_precedence_3();
+    }
+
+    // Parses the expression of statement `index` into its ops.
+    constexpr void parse_stmt_expr(const size_t index) {
+        const auto begin = static_cast<uint32_t>(program.ops.size());
+        parse_expr();
+        ConstexprStmt &stmt = program.statements[index];
+        stmt.expr_begin = begin;
+        stmt.expr_end = static_cast<uint32_t>(program.ops.size());
+        for (uint32_t i = begin; i < stmt.expr_end; i++) {
+            if (program.ops[i].kind == FlatOpKind::Name) {
+                stmt.reads.insert(program.ops[i].name);
+            }
+        }
+    }
+
+    constexpr void parse_stmt(const Name &name) {
+        // the statement takes its index before the ones nested in it, to keep them in source order
+        const size_t index = program.statements.size();
+        program.statements.push_back(ConstexprStmt{.kind = ConstexprStmtKind::Assignment, .name = name});
+        if (name == "if" || name == "while") {
+            program.statements[index].kind = name == "if" ? ConstexprStmtKind::If : ConstexprStmtKind::While;
+            parse_stmt_expr(index);
+            const auto [body_begin, body_end] = parse_stmt_list(false);
+            program.statements[index].body_begin = body_begin;
+            program.statements[index].body_end = body_end;
+            return;
+        }
+        lexer.skip_whitespace();
+        if (lexer.eof()) {
+            throw std::runtime_error("Unexpected end of input");
+        }
+        if (lexer.next() != '=') {
+            throw std::runtime_error("Expected '='");
+        }
+
+        parse_stmt_expr(index);
+        program.statements[index].span = Span{name.span.start, static_cast<uint32_t>(lexer.pre_ws_pos)};
+    }
+
+    constexpr std::pair<uint32_t, uint32_t> parse_stmt_list(const bool error_on_end) {
+        std::vector<uint32_t> list;
+
+        lexer.skip_whitespace();
+        while (!lexer.eof()) {
+            // we are also going to consume the end, or error if error_on_end = true
+            const Name name = lexer.read_name();
+            if (name == "end") {
+                if (error_on_end) {
+                    throw std::runtime_error("Unexpected end");
+                }
+                break;
+            }
+            list.push_back(static_cast<uint32_t>(program.statements.size()));
+            parse_stmt(name);
+            lexer.skip_whitespace();
+        }
+
+        // nested lists are complete by now, so this one goes in one piece after them
+        const auto begin = static_cast<uint32_t>(program.lists.size());
+        program.lists.insert(program.lists.end(), list.begin(), list.end());
+        return {begin, static_cast<uint32_t>(program.lists.size())};
+    }
+
+public:
+    constexpr explicit ConstexprParser(const std::string_view src) : lexer{src} {
+    }
+
+    constexpr ConstexprProgram parse() && {
+        if (lexer.input.size() > Span::max_offset) {
+            throw std::runtime_error("Input too large, a single buffer is limited to 4 GiB");
+        }
+        const auto [begin, end] = parse_stmt_list(true);
+        program.top_begin = begin;
+        program.top_end = end;
+        return std::move(program);
+    }
+};
+
+// fold_constant_branches, build_cfg, build_dfg and analyse_dfg over a ConstexprProgram, with the same
+// worklist, in the same order, so that the results come out the same.
+class ConstexprAnalysis {
+    const ConstexprProgram &program;
+    NameSet whole_program_outputs;
+    // by statement index
+    std::vector<ConstantCondition> folded;
+    std::vector<bool> unused;
+    std::vector<int32_t> stack;
+
+    struct Constants {
+        NameSet known;
+        std::array<int32_t, 256> values{};
+
+        constexpr int32_t get(const char name) const {
+            return values[static_cast<unsigned char>(name)];
+        }
+
+        constexpr void set(const char name, const int32_t value) {
+            known.insert(name);
+            values[static_cast<unsigned char>(name)] = value;
+        }
+
+        // Keeps the constants both agree on.
+        constexpr void join(const Constants &other) {
+            for (size_t i = 0; i < values.size(); i++) {
+                const auto name = static_cast<char>(i);
+                if (known.contains(name) && (!other.known.contains(name) || other.get(name) != get(name))) {
+                    known.erase(name);
+                }
+            }
+        }
+    };
+
+    constexpr const ConstexprStmt &statement(const uint32_t list_index) const {
+        return program.statements[program.lists[list_index]];
+    }
+
+    // See BranchFolder::evaluate.
+    constexpr bool evaluate(const ConstexprStmt &stmt, const Constants &constants, int32_t &value) {
+        for (size_t i = 0; i < constants.known.words.size(); i++) {
+            if ((stmt.reads.words[i] & ~constants.known.words[i]) != 0) {
+                return false;
+            }
+        }
+        stack.clear();
+        for (uint32_t i = stmt.expr_begin; i < stmt.expr_end; i++) {
+            const FlatOp &op = program.ops[i];
+            if (op.kind == FlatOpKind::Name) {
+                stack.push_back(constants.get(op.name));
+            } else if (op.kind == FlatOpKind::Constant) {
+                stack.push_back(op.value);
+            } else {
+                const int32_t rhs = stack.back();
+                stack.pop_back();
+                if (op.kind == FlatOpKind::Div && rhs == 0) {
+                    return false;
+                }
+                stack.back() = apply_binary_op(op.kind, stack.back(), rhs);
+            }
+        }
+        value = stack.back();
+        return true;
+    }
+
+    constexpr void collect_assigned(const uint32_t begin, const uint32_t end, NameSet &names) const {
+        for (uint32_t i = begin; i < end; i++) {
+            const ConstexprStmt &stmt = statement(i);
+            if (stmt.kind == ConstexprStmtKind::Assignment) {
+                names.insert(stmt.name.name[0]);
+            } else {
+                collect_assigned(stmt.body_begin, stmt.body_end, names);
+            }
+        }
+    }
+
+    // See BranchFolder::walk.
+    constexpr void fold(const uint32_t begin, const uint32_t end, Constants &constants) {
+        for (uint32_t i = begin; i < end; i++) {
+            const ConstexprStmt &stmt = statement(i);
+            int32_t value = 0;
+            const bool known = evaluate(stmt, constants, value);
+            switch (stmt.kind) {
+                case ConstexprStmtKind::Assignment:
+                    if (known) {
+                        constants.set(stmt.name.name[0], value);
+                    } else {
+                        constants.known.erase(stmt.name.name[0]);
+                    }
+                    break;
+                case ConstexprStmtKind::If:
+                    if (!known) {
+                        Constants taken = constants;
+                        fold(stmt.body_begin, stmt.body_end, taken);
+                        constants.join(taken);
+                    } else if (value != 0) {
+                        folded[program.lists[i]] = ConstantCondition::AlwaysTrue;
+                        fold(stmt.body_begin, stmt.body_end, constants);
+                    } else {
+                        folded[program.lists[i]] = ConstantCondition::AlwaysFalse;
+                    }
+                    break;
+                case ConstexprStmtKind::While: {
+                    if (known && value == 0) {
+                        folded[program.lists[i]] = ConstantCondition::AlwaysFalse;
+                        break;
+                    }
+                    NameSet assigned;
+                    collect_assigned(stmt.body_begin, stmt.body_end, assigned);
+                    for (size_t w = 0; w < assigned.words.size(); w++) {
+                        constants.known.words[w] &= ~assigned.words[w];
+                    }
+                    Constants body = constants;
+                    fold(stmt.body_begin, stmt.body_end, body);
+                    break;
+                }
+            }
+        }
+    }
+
+    static constexpr uint32_t no_node = UINT32_MAX;
+
+    enum class NodeKind : uint8_t {
+        Block,
+        If,
+        While,
+        WhileEnd,
+        Exit,
+    };
+
+    // A node of the CFG of build_cfg, with the edges build_dfg gives it.
+    struct Node {
+        NodeKind kind = NodeKind::Block;
+        uint32_t next = no_node;
+        // the then branch of an if, the body of a while, the while of a while end
+        uint32_t branch = no_node;
+        // the while end of a while
+        uint32_t end = no_node;
+        // the statement of an if or a while
+        uint32_t stmt = no_node;
+        // the statements of a block, in order
+        std::vector<uint32_t> assignments{};
+        std::vector<uint32_t> in_nodes{};
+        std::vector<uint32_t> out_nodes{};
+    };
+
+    std::vector<Node> nodes;
+    // by node, see DfgNodeInputs
+    std::vector<NameSet> inputs;
+
+    constexpr uint32_t add_node(Node node) {
+        nodes.push_back(std::move(node));
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+
+    // See CfgBuilder, down to which assignments end up sharing a block.
+    constexpr uint32_t build_cfg(const uint32_t begin, const uint32_t end, uint32_t entry, bool allow_direct_basic_link) {
+        for (uint32_t i = end; i-- > begin;) {
+            const uint32_t index = program.lists[i];
+            const ConstexprStmt &stmt = program.statements[index];
+            switch (stmt.kind) {
+                case ConstexprStmtKind::Assignment:
+                    if (nodes[entry].kind == NodeKind::Block && allow_direct_basic_link) {
+                        nodes[entry].assignments.insert(nodes[entry].assignments.begin(), index);
+                        break;
+                    }
+                    if (nodes[entry].kind == NodeKind::Block) {
+                        allow_direct_basic_link = true;
+                    }
+                    entry = add_node(Node{.kind = NodeKind::Block, .next = entry, .assignments = {index}});
+                    break;
+                case ConstexprStmtKind::If: {
+                    const uint32_t then_branch = build_cfg(stmt.body_begin, stmt.body_end, entry, false);
+                    entry = add_node(Node{.kind = NodeKind::If, .next = entry, .branch = then_branch, .stmt = index});
+                    break;
+                }
+                case ConstexprStmtKind::While: {
+                    const uint32_t while_end = add_node(Node{.kind = NodeKind::WhileEnd, .next = entry});
+                    const uint32_t body = build_cfg(stmt.body_begin, stmt.body_end, while_end, true);
+                    entry = add_node(Node{
+                            .kind = NodeKind::While, .next = entry, .branch = body, .end = while_end, .stmt = index,
+                    });
+                    nodes[while_end].branch = entry;
+                    break;
+                }
+            }
+        }
+        return entry;
+    }
+
+    // See forward_link_dfg_nodes and backward_link_dfg_nodes; the recursion of the former only ever goes on with
+    // the last node it links, so it is a loop here, and the latter gets an explicit stack.
+    constexpr void link(const uint32_t entry) {
+        for (uint32_t node = entry; node != no_node;) {
+            Node &n = nodes[node];
+            const ConstantCondition condition =
+                    n.stmt == no_node ? ConstantCondition::Unknown : folded[n.stmt];
+            switch (n.kind) {
+                case NodeKind::Block:
+                    n.out_nodes.push_back(n.next);
+                    node = n.next;
+                    break;
+                case NodeKind::If:
+                    if (condition != ConstantCondition::AlwaysFalse) {
+                        n.out_nodes.push_back(n.branch);
+                    }
+                    if (condition != ConstantCondition::AlwaysTrue) {
+                        n.out_nodes.push_back(n.next);
+                    }
+                    node = condition == ConstantCondition::AlwaysFalse ? n.next : n.branch;
+                    break;
+                case NodeKind::While:
+                    if (condition == ConstantCondition::AlwaysFalse) {
+                        n.out_nodes.push_back(n.next);
+                        node = n.next;
+                        break;
+                    }
+                    n.out_nodes.push_back(n.branch);
+                    n.out_nodes.push_back(n.next);
+                    node = n.branch;
+                    break;
+                case NodeKind::WhileEnd:
+                    n.out_nodes.push_back(n.branch);
+                    node = n.next;
+                    break;
+                case NodeKind::Exit:
+                    node = no_node;
+                    break;
+            }
+        }
+
+        // the node and the next of its out nodes to go to
+        std::vector<std::pair<uint32_t, size_t>> stack{{entry, 0}};
+        while (!stack.empty()) {
+            auto &[node, out_index] = stack.back();
+            if (out_index == nodes[node].out_nodes.size()) {
+                stack.pop_back();
+                continue;
+            }
+            const uint32_t from = node;
+            const uint32_t out_node = nodes[from].out_nodes[out_index++];
+            std::vector<uint32_t> &in_nodes = nodes[out_node].in_nodes;
+            if (std::ranges::find(in_nodes, from) != in_nodes.end()) {
+                continue;
+            }
+            in_nodes.push_back(from);
+            stack.emplace_back(out_node, 0);
+        }
+    }
+
+    // See compute_dfg_node_inputs.
+    constexpr NameSet block_inputs(const Node &block, NameSet live) {
+        for (auto it = block.assignments.rbegin(); it != block.assignments.rend(); ++it) {
+            const ConstexprStmt &stmt = program.statements[*it];
+            if (stmt.name.name.length() != 1) {
+                throw std::runtime_error("Invalid name length");
+            }
+            const char name = stmt.name.name[0];
+            if (live.contains(name)) {
+                live.erase(name);
+            } else {
+                unused[*it] = true;
+            }
+            live |= stmt.reads;
+        }
+        return live;
+    }
+
+    // See next_work_list_node.
+    constexpr uint32_t next_work_list_node(std::vector<uint32_t> &work_list, const std::vector<bool> &visited) const {
+        for (size_t i = 0; i < work_list.size(); i++) {
+            const uint32_t candidate = work_list[i];
+            if (std::ranges::all_of(nodes[candidate].out_nodes, [&](const uint32_t out) { return visited[out]; })) {
+                work_list.erase(work_list.begin() + static_cast<ptrdiff_t>(i));
+                return candidate;
+            }
+        }
+        const uint32_t candidate = work_list.back();
+        work_list.pop_back();
+        return candidate;
+    }
+
+    // See compute_dfg_node_inputs_for_while: the body is analysed with the whole program outputs live at its end,
+    // then again with what that found live at its start.
+    constexpr NameSet while_inputs(const Node &while_node, const std::vector<bool> &visited) {
+        const NameSet &condition = program.statements[while_node.stmt].reads;
+        const std::vector<uint32_t> initial_work_list = nodes[while_node.end].in_nodes;
+        std::vector<uint32_t> work_list = initial_work_list;
+        std::vector<bool> body_visited = visited;
+        inputs[while_node.end] = whole_program_outputs;
+        inputs[while_node.end] |= condition;
+        analyse(work_list, body_visited);
+
+        NameSet local = inputs[while_node.branch];
+        local |= condition;
+        work_list = initial_work_list;
+        body_visited = visited;
+        inputs[while_node.end] = local;
+        analyse(work_list, body_visited);
+
+        local = inputs[while_node.branch];
+        local |= condition;
+        return local;
+    }
+
+    // See analyse_dfg_impl.
+    constexpr void analyse(std::vector<uint32_t> &work_list, std::vector<bool> &visited) {
+        while (!work_list.empty()) {
+            const uint32_t node = next_work_list_node(work_list, visited);
+            if (visited[node]) {
+                continue;
+            }
+            visited[node] = true;
+
+            const Node &n = nodes[node];
+            NameSet required;
+            for (const uint32_t out_node: n.out_nodes) {
+                required |= inputs[out_node];
+            }
+            switch (n.kind) {
+                case NodeKind::Block:
+                    inputs[node] = block_inputs(n, required);
+                    break;
+                case NodeKind::While:
+                    if (folded[n.stmt] != ConstantCondition::AlwaysFalse) {
+                        inputs[node] = while_inputs(n, visited);
+                        for (const uint32_t in_node: n.in_nodes) {
+                            if (in_node != n.end) {
+                                work_list.push_back(in_node);
+                            }
+                        }
+                        continue;
+                    }
+                    [[fallthrough]];
+                case NodeKind::If:
+                    inputs[node] = required;
+                    inputs[node] |= program.statements[n.stmt].reads;
+                    break;
+                case NodeKind::WhileEnd:
+                case NodeKind::Exit:
+                    inputs[node] = required;
+                    break;
+            }
+            work_list.insert(work_list.end(), n.in_nodes.begin(), n.in_nodes.end());
+        }
+    }
+
+public:
+    constexpr explicit ConstexprAnalysis(const ConstexprProgram &program)
+        : program(program), folded(program.statements.size(), ConstantCondition::Unknown),
+          unused(program.statements.size(), false) {
+    }
+
+    // Marks the unused assignments, by statement index; see analyse_source.
+    constexpr const std::vector<bool> &analyse() {
+        for (const ConstexprStmt &stmt: program.statements) {
+            // compute_whole_program_required_outputs counts the assigned names too
+            if (stmt.kind == ConstexprStmtKind::Assignment) {
+                whole_program_outputs.insert(stmt.name.name[0]);
+            }
+            whole_program_outputs |= stmt.reads;
+        }
+        Constants constants;
+        fold(program.top_begin, program.top_end, constants);
+
+        const uint32_t exit = add_node(Node{.kind = NodeKind::Exit});
+        const uint32_t entry = build_cfg(program.top_begin, program.top_end, exit, true);
+        link(entry);
+        inputs.resize(nodes.size());
+        inputs[exit] = whole_program_outputs;
+        std::vector<uint32_t> work_list = nodes[exit].in_nodes;
+        std::vector<bool> visited(nodes.size(), false);
+        analyse(work_list, visited);
+        return unused;
+    }
+};
+
+// Runs parse, constant folding and liveness over `src`, and returns the same results as analyse_source, sorted by
+// span start, with names pointing into `src`. Throws std::runtime_error if there are more than `Capacity`.
+template<size_t Capacity = 64>
+constexpr FixedVector<UnusedAssignment, Capacity> analyse_source_constexpr(const std::string_view src) {
+    const ConstexprProgram program = ConstexprParser{src}.parse();
+    ConstexprAnalysis analysis{program};
+    const std::vector<bool> &unused = analysis.analyse();
+
+    FixedVector<UnusedAssignment, Capacity> result;
+    // statements come in source order, so the line only ever moves forward
+    size_t line = 1;
+    size_t line_start = 0;
+    size_t scanned = 0;
+    for (size_t i = 0; i < program.statements.size(); i++) {
+        if (!unused[i]) {
+            continue;
+        }
+        const ConstexprStmt &stmt = program.statements[i];
+        for (; scanned < stmt.span.start; scanned++) {
+            if (src[scanned] == '\n') {
+                line++;
+                line_start = scanned + 1;
+            }
+        }
+        result.push_back(UnusedAssignment{
+                .name = stmt.name.name,
+                .start = stmt.span.start,
+                .end = stmt.span.end,
+                .line = line,
+                .column = stmt.span.start - line_start + 1,
+        });
+    }
+    return result;
+}
+
+#endif //DFA_SAMPLE_CONSTEXPR_ANALYSIS_HPP
@@ -0,0 +1,101 @@
+#include "dead_stores.hpp"
+#include <algorithm>
+#include "incremental.hpp"
+#include "trace.hpp"
+
+static bool is_blank(const char c) {
+    return c == ' ' || c == '\t';
+}
+
+// The text to delete for the assignment at [start, end) of `src`: its whole line if nothing else is on it, or else
+// the assignment and the blanks after it.
+static TextEdit deletion(const std::string &src, const size_t start, const size_t end) {
+    size_t line_begin = start;
+    while (line_begin > 0 && is_blank(src[line_begin - 1])) {
+        line_begin--;
+    }
+    size_t after = end;
+    while (after < src.size() && is_blank(src[after])) {
+        after++;
+    }
+    if (line_begin == 0 || src[line_begin - 1] == '\n') {
+        if (after + 1 < src.size() && src[after] == '\r' && src[after + 1] == '\n') {
+            return TextEdit{.start = line_begin, .end = after + 2, .replacement = {}};
+        }
+        if (after == src.size() || src[after] == '\n') {
+            return TextEdit{.start = line_begin, .end = std::min(after + 1, src.size()), .replacement = {}};
+        }
+    }
+    return TextEdit{.start = start, .end = after, .replacement = {}};
+}
+
+// The parts of the original source deleted so far, to map offsets in the current source back to it.
+class DeletedRanges {
+    // sorted, disjoint and not touching
+    std::vector<std::pair<size_t, size_t>> ranges;
+
+public:
+    [[nodiscard]] size_t original_offset(size_t offset) const {
+        for (const auto &[start, end]: ranges) {
+            if (start > offset) {
+                break;
+            }
+            offset += end - start;
+        }
+        return offset;
+    }
+
+    // Adds the current [start, end), which may span ranges deleted before.
+    void add(const size_t start, const size_t end) {
+        const size_t original_start = original_offset(start);
+        const size_t original_end = original_offset(end - 1) + 1;
+        auto first = std::ranges::lower_bound(ranges, original_start, {}, &std::pair<size_t, size_t>::second);
+        auto last = std::ranges::upper_bound(ranges, original_end, {}, &std::pair<size_t, size_t>::first);
+        std::pair merged{original_start, original_end};
+        if (first != last) {
+            merged.first = std::min(merged.first, first->first);
+            merged.second = std::max(merged.second, (last - 1)->second);
+        }
+        ranges.insert(ranges.erase(first, last), merged);
+    }
+};
+
+DeadStoreElimination eliminate_dead_stores(const std::string_view src) {
+    TraceScope trace{"eliminate_dead_stores"};
+    const LineIndex lines = LineIndex::build(src);
+    IncrementalAnalysis analysis{src};
+    DeadStoreElimination result;
+    result.reparsed = analysis.last_reparsed;
+    result.reanalysed = analysis.last_reanalysed;
+
+    DeletedRanges deleted;
+    for (std::vector<UnusedAssignment> unused = analysis.unused_assignments(); !unused.empty();
+         unused = analysis.unused_assignments()) {
+        const std::string current = analysis.source();
+        std::vector<TextEdit> edits;
+        edits.reserve(unused.size());
+        for (const UnusedAssignment &assignment: unused) {
+            const size_t start = deleted.original_offset(assignment.start);
+            const auto [line, column] = lines.locate(start);
+            result.removed.push_back(UnusedAssignment{
+                    .name = src.substr(start, assignment.name.size()),
+                    .start = start,
+                    .end = deleted.original_offset(assignment.end - 1) + 1,
+                    .line = line,
+                    .column = column,
+            });
+            edits.push_back(deletion(current, assignment.start, assignment.end));
+        }
+        for (const TextEdit &edit: edits) {
+            deleted.add(edit.start, edit.end);
+        }
+        analysis.apply_edits(std::move(edits));
+        result.rounds++;
+        result.reparsed += analysis.last_reparsed;
+        result.reanalysed += analysis.last_reanalysed;
+    }
+
+    std::ranges::sort(result.removed, {}, &UnusedAssignment::start);
+    result.source = analysis.source();
+    return result;
+}
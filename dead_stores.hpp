@@ -0,0 +1,28 @@
+#ifndef DFA_SAMPLE_DEAD_STORES_HPP
+#define DFA_SAMPLE_DEAD_STORES_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "analysis.hpp"
+
+struct DeadStoreElimination {
+    // the source without the removed assignments
+    std::string source;
+    // every assignment removed, with spans, lines and names into the original source, sorted by span start
+    std::vector<UnusedAssignment> removed;
+    // analyses that found something to remove
+    size_t rounds = 0;
+    // top-level statements parsed and analysed over all the rounds, the first analysis included
+    size_t reparsed = 0;
+    size_t reanalysed = 0;
+};
+
+// Removes the assignments analyse_source reports unused, then the ones that removing those leaves unused, and so
+// on until there are none. The rounds go through an IncrementalAnalysis: only the top-level statements that lost
+// an assignment are parsed again, and only those whose live variables changed are analysed again, so all the
+// rounds together cost little more than the first one. An assignment alone on its line goes with its line.
+// Throws std::runtime_error like analyse_source.
+DeadStoreElimination eliminate_dead_stores(std::string_view src);
+
+#endif //DFA_SAMPLE_DEAD_STORES_HPP
@@ -0,0 +1,88 @@
+#include "dfa_core.hpp"
+#include <algorithm>
+#include "cfg.hpp"
+#include "constant_propagation.hpp"
+#include "dfa_core.h"
+#include "dfg.hpp"
+#include "intern.hpp"
+#include "parse.hpp"
+
+Analyzer::Analyzer(const MemoryResourceKind scratch, const bool hash_cons)
+    : memory(scratch), interner(hash_cons ? std::make_unique<ExprInterner>() : nullptr) {
+}
+
+Analyzer::~Analyzer() = default;
+
+void Analyzer::analyse(const std::string_view src, std::vector<UnusedAssignment> &results) {
+    const PhaseMemory phases = memory.phases();
+    try {
+        ParserState state{Lexer{src}, phases.parse, interner.get()};
+        const Program p = parse_program(state);
+        Cfg cfg = build_cfg(p, phases.cfg);
+        ConstantState constants;
+        fold_constant_branches(cfg, constants);
+        const Dfg dfg = build_dfg(cfg, phases.dfg);
+        DfgNodeOutputs outputs;
+        compute_whole_program_required_outputs(p, outputs);
+        analyse_dfg(dfg, outputs, unused_assignments, phases.analysis);
+        sorted_unused_assignments(unused_assignments, state.lexer.lines, results);
+    } catch (...) {
+        unused_assignments.assignments.clear();
+        if (interner) {
+            interner->clear();
+        }
+        memory.release();
+        throw;
+    }
+    // the vector keeps its capacity for the next call, but nothing from the scratch memory may outlive it
+    unused_assignments.assignments.clear();
+    if (interner) {
+        interner->clear();
+    }
+    memory.release();
+}
+
+struct dfa_analyzer {
+    Analyzer analyzer;
+    std::vector<UnusedAssignment> results;
+    std::string error;
+};
+
+dfa_analyzer *dfa_analyzer_create() {
+    try {
+        return new dfa_analyzer{};
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void dfa_analyzer_destroy(dfa_analyzer *analyzer) {
+    delete analyzer;
+}
+
+ptrdiff_t dfa_analyze(dfa_analyzer *analyzer, const char *src, const size_t size, dfa_unused_assignment *results,
+                      const size_t capacity) {
+    try {
+        analyzer->analyzer.analyse(std::string_view{src, size}, analyzer->results);
+    } catch (const std::exception &e) {
+        analyzer->error = e.what();
+        return -1;
+    }
+    const size_t stored = std::min(capacity, analyzer->results.size());
+    for (size_t i = 0; i < stored; i++) {
+        const UnusedAssignment &assignment = analyzer->results[i];
+        results[i] = dfa_unused_assignment{
+                .name = assignment.name.data(),
+                .name_length = assignment.name.size(),
+                .start = assignment.start,
+                .end = assignment.end,
+                .line = assignment.line,
+                .column = assignment.column,
+        };
+    }
+    return static_cast<ptrdiff_t>(analyzer->results.size());
+}
+
+const char *dfa_analyzer_error(const dfa_analyzer *analyzer) {
+    return analyzer->error.c_str();
+}
@@ -0,0 +1,42 @@
+#ifndef DFA_SAMPLE_DFA_CORE_H
+#define DFA_SAMPLE_DFA_CORE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct dfa_analyzer dfa_analyzer;
+
+typedef struct dfa_unused_assignment {
+    /* the assigned name, pointing into the analysed source */
+    const char *name;
+    size_t name_length;
+    /* byte range of the assignment in the source */
+    size_t start;
+    size_t end;
+    /* 1-based, columns in bytes */
+    size_t line;
+    size_t column;
+} dfa_unused_assignment;
+
+/* Returns NULL if out of memory. An analyzer must not be used by two threads at once. */
+dfa_analyzer *dfa_analyzer_create(void);
+
+void dfa_analyzer_destroy(dfa_analyzer *analyzer);
+
+/* Analyses the `size` bytes at `src`, storing the first `capacity` unused assignments (sorted by start) in
+ * `results`. Returns how many there are in all, which may be more than `capacity`, or -1 if the source cannot be
+ * analysed; dfa_analyzer_error then tells why. */
+ptrdiff_t dfa_analyze(dfa_analyzer *analyzer, const char *src, size_t size, dfa_unused_assignment *results,
+                      size_t capacity);
+
+/* The message of the last failed dfa_analyze, valid until the next call on the same analyzer. */
+const char *dfa_analyzer_error(const dfa_analyzer *analyzer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DFA_SAMPLE_DFA_CORE_H */
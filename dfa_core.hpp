@@ -0,0 +1,30 @@
+#ifndef DFA_SAMPLE_DFA_CORE_HPP
+#define DFA_SAMPLE_DFA_CORE_HPP
+
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "analysis.hpp"
+#include "memory.hpp"
+
+class ExprInterner;
+
+// The in-process API of dfa_core. An Analyzer runs analyses one after the other, keeping its scratch memory from
+// one to the next; it is not thread-safe, so concurrent callers use one each. The C ABI in dfa_core.h wraps it.
+class Analyzer {
+    PhaseMemoryResources memory;
+    DfgNodeUnusedAssignments unused_assignments;
+    // set when hash-consing; its nodes live in the scratch memory, so it is cleared along with it
+    std::unique_ptr<ExprInterner> interner;
+
+public:
+    explicit Analyzer(MemoryResourceKind scratch = MemoryResourceKind::Pool, bool hash_cons = false);
+    ~Analyzer();
+
+    // Analyses the caller's `src` and replaces the contents of `results` with its unused assignments, sorted by
+    // start. The names point into `src`. Throws std::runtime_error if `src` is not a valid program, including one
+    // with a number that does not fit in an int.
+    void analyse(std::string_view src, std::vector<UnusedAssignment> &results);
+};
+
+#endif //DFA_SAMPLE_DFA_CORE_HPP
@@ -3,6 +3,9 @@
 //
 
 #include "dfg.hpp"
+#include <unistd.h>
+#include "graph_export.hpp"
+#include "trace.hpp"
 
 std::shared_ptr<DfgNode> dfg_ptr_for_cfg(const Dfg& dfg, const CfgNode& cfg_node) {
     for (const auto& node: dfg.nodes) {
@@ -13,19 +16,28 @@ std::shared_ptr<DfgNode> dfg_ptr_for_cfg(const Dfg& dfg, const CfgNode& cfg_node
     throw std::runtime_error("Could not find dfg node for cfg node");
 }
 
-static void build_dfg_nodes(const std::shared_ptr<CfgNode>& cfg_node, Dfg& dfg) {
-    dfg.nodes.push_back(std::make_shared<DfgNode>(DfgNode(cfg_node)));
+static void build_dfg_nodes(const std::shared_ptr<CfgNode>& cfg_node, Dfg& dfg,
+                            std::pmr::memory_resource* memory) {
+    dfg.nodes.push_back(make_shared_in<DfgNode>(memory, DfgNode(cfg_node)));
     std::visit(
         [&]<typename T0>(T0&& node) {
             using T = std::decay_t<T0>;
             if constexpr (std::is_same_v<T, BasicCfgBlock>
                           || std::is_same_v<T, std::shared_ptr<WhileRetDummyCfgNode>>) {
-                build_dfg_nodes(cfg_node->next, dfg);
+                build_dfg_nodes(cfg_node->next, dfg, memory);
             } else if constexpr (std::is_same_v<T, IfCfgNode>) {
-                build_dfg_nodes(node.then_branch, dfg);
-                // will eventually reach outside the if, not for us to worry about
+                if (node.folded == ConstantCondition::AlwaysFalse) {
+                    build_dfg_nodes(cfg_node->next, dfg, memory);
+                } else {
+                    build_dfg_nodes(node.then_branch, dfg, memory);
+                    // will eventually reach outside the if, not for us to worry about
+                }
             } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileCfgNode>>) {
-                build_dfg_nodes(node->body, dfg);
+                if (node->folded == ConstantCondition::AlwaysFalse) {
+                    build_dfg_nodes(cfg_node->next, dfg, memory);
+                } else {
+                    build_dfg_nodes(node->body, dfg, memory);
+                }
             } else if constexpr (std::is_same_v<T, ExitCfgNode>) {
             } else {
                 static_assert(false, "non-exhaustive visitor!");
@@ -43,11 +55,21 @@ static void forward_link_dfg_nodes(const std::shared_ptr<CfgNode>& cfg_node, Dfg
                 forward_link_dfg_nodes(cfg_node->next, dfg);
             } else if constexpr (std::is_same_v<T, IfCfgNode>) {
                 const std::shared_ptr<DfgNode> dfg_node = dfg_ptr_for_cfg(dfg, *cfg_node);
-                dfg_node->out_nodes.push_back(dfg_ptr_for_cfg(dfg, *node.then_branch));
-                dfg_node->out_nodes.push_back(dfg_ptr_for_cfg(dfg, *cfg_node->next));
-                forward_link_dfg_nodes(node.then_branch, dfg);
+                if (node.folded != ConstantCondition::AlwaysFalse) {
+                    dfg_node->out_nodes.push_back(dfg_ptr_for_cfg(dfg, *node.then_branch));
+                }
+                if (node.folded != ConstantCondition::AlwaysTrue) {
+                    dfg_node->out_nodes.push_back(dfg_ptr_for_cfg(dfg, *cfg_node->next));
+                }
+                forward_link_dfg_nodes(node.folded == ConstantCondition::AlwaysFalse ? cfg_node->next
+                                                                                     : node.then_branch, dfg);
             } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileCfgNode>>) {
                 const std::shared_ptr<DfgNode> dfg_node = dfg_ptr_for_cfg(dfg, *cfg_node);
+                if (node->folded == ConstantCondition::AlwaysFalse) {
+                    dfg_node->out_nodes.push_back(dfg_ptr_for_cfg(dfg, *cfg_node->next));
+                    forward_link_dfg_nodes(cfg_node->next, dfg);
+                    return;
+                }
                 dfg_node->out_nodes.push_back(dfg_ptr_for_cfg(dfg, *node->body));
                 dfg_node->out_nodes.push_back(dfg_ptr_for_cfg(dfg, *cfg_node->next));
                 forward_link_dfg_nodes(node->body, dfg);
@@ -86,10 +108,11 @@ static void backward_link_dfg_nodes(Dfg& dfg, std::shared_ptr<DfgNode> node,
     }
 }
 
-Dfg build_dfg(const Cfg& cfg) {
+Dfg build_dfg(const Cfg& cfg, std::pmr::memory_resource* memory) {
+    TraceScope trace{"build_dfg"};
     Dfg dfg;
 
-    build_dfg_nodes(cfg.entry, dfg);
+    build_dfg_nodes(cfg.entry, dfg, memory);
     forward_link_dfg_nodes(cfg.entry, dfg);
     backward_link_dfg_nodes(dfg, dfg_ptr_for_cfg(dfg, *cfg.entry), std::nullopt);
 
@@ -97,18 +120,7 @@ Dfg build_dfg(const Cfg& cfg) {
 }
 
 void dbg_dfg(const Dfg& dfg) {
-    for (size_t i = 0; i < dfg.nodes.size(); i++) {
-        std::cout << "node " << i << ":" << std::endl;
-        std::cout << "    cfg_node:\n";
-        dbg_cfg_node_at_indent(*dfg.nodes[i]->cfg_node, 4);
-        std::cout << "    in_nodes:\n";
-        for (const auto& in_node: dfg.nodes[i]->in_nodes) {
-            dbg_cfg_node_at_indent(*in_node.lock()->cfg_node, 8);
-        }
-
-        std::cout << "    out_nodes:\n";
-        for (const auto& out_node: dfg.nodes[i]->out_nodes) {
-            dbg_cfg_node_at_indent(*out_node.lock()->cfg_node, 8);
-        }
-    }
+    std::cout.flush();
+    ReportBuffer out{STDOUT_FILENO};
+    export_dfg(dfg, GraphFormat::Dot, out);
 }
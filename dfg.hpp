@@ -33,7 +33,9 @@ public:
 
 std::shared_ptr<DfgNode> dfg_ptr_for_cfg(const Dfg &dfg, const CfgNode &cfg_node);
 
+// Writes `dfg` to stdout in DOT, see export_dfg.
 void dbg_dfg(const Dfg &dfg);
-Dfg build_dfg(const Cfg &cfg);
+// The nodes are allocated from `memory`.
+Dfg build_dfg(const Cfg &cfg, std::pmr::memory_resource *memory = std::pmr::get_default_resource());
 
 #endif //DFA_SAMPLE_DFG_HPP
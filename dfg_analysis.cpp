@@ -3,24 +3,31 @@
 //
 
 #include "dfg_analysis.hpp"
+#include <algorithm>
 #include <map>
+#include "stats.hpp"
+#include "trace.hpp"
 
-struct InputsReadVisitor : public AstVisitor {
+struct InputsReadVisitor : public StaticAstVisitor<InputsReadVisitor> {
     std::set<char> inputs;
 
-    void visit_name(const Name &name) override {
+    void visit_name(const Name &name) {
         inputs.insert(name.name[0]);
     }
 };
 
+// Adds the variables `expr` reads to `names`.
+static void insert_read_names(const FlatExpr &expr, std::set<char> &names) {
+    names.insert(expr.reads.begin(), expr.reads.end());
+}
 
 struct AnalyseDfgContext {
     const Dfg &dfg;
     DfgNodeOutputs outputs;
     DfgNodeUnusedAssignments &unused_assignments;
-    std::vector<std::shared_ptr<DfgNode>> &work_list;
-    std::set<DfgNode *> &visited;
-    std::map<DfgNode *, DfgNodeInout> &inouts;
+    std::pmr::vector<std::shared_ptr<DfgNode>> &work_list;
+    std::pmr::set<DfgNode *> &visited;
+    std::pmr::map<DfgNode *, DfgNodeInout> &inouts;
 };
 
 static void analyse_dfg_impl(AnalyseDfgContext &context);
@@ -49,9 +56,7 @@ static DfgNodeInputs compute_dfg_node_inputs(const BasicCfgBlock &block, const D
             }
         }
 
-        InputsReadVisitor visitor;
-        visitor.visit_expr(*assignment->expr);
-        required_outputs.out.insert(visitor.inputs.begin(), visitor.inputs.end());
+        insert_read_names(*assignment->flat, required_outputs.out);
     }
 
     DfgNodeInputs inputs;
@@ -98,13 +103,21 @@ void dbg_inouts(const std::shared_ptr<DfgNode> &node, const DfgNodeInout &inout)
 static DfgNodeInputs
 compute_dfg_node_inputs_for_while(const std::shared_ptr<WhileCfgNode> &while_node,
                                   const std::shared_ptr<CfgNode> &while_cfg_node, AnalyseDfgContext &context) {
-    std::set<DfgNode *> vis = context.visited;
+    count_analysis_event(&AnalysisCounters::loop_solves);
+    TraceScope trace{"while_solve"};
+    std::visit([&](const auto &condition) {
+        trace.arg(0, "start", condition.span.start);
+        trace.arg(1, "end", condition.span.end);
+    }, while_node->condition->data);
+    // the copies stay in the memory resource of the analysis
+    std::pmr::memory_resource *memory = context.work_list.get_allocator().resource();
+    std::pmr::set<DfgNode *> vis{context.visited, memory};
     std::shared_ptr<DfgNode> end_node = dfg_ptr_for_while_end_dummy_node(context.dfg, while_cfg_node);
-    std::vector<std::shared_ptr<DfgNode>> init_wl;
+    std::pmr::vector<std::shared_ptr<DfgNode>> init_wl{memory};
     for (const auto &in_node: end_node->in_nodes) {
         init_wl.push_back(in_node.lock());
     }
-    std::vector<std::shared_ptr<DfgNode>> wl = init_wl;
+    std::pmr::vector<std::shared_ptr<DfgNode>> wl{init_wl, memory};
 
     AnalyseDfgContext new_context = AnalyseDfgContext{
             .dfg = context.dfg,
@@ -115,30 +128,28 @@ compute_dfg_node_inputs_for_while(const std::shared_ptr<WhileCfgNode> &while_nod
             .inouts = context.inouts,
     };
     DfgNodeInputs required_inputs = DfgNodeInputs{.in = context.outputs.out};
-    InputsReadVisitor visitor;
-    visitor.visit_expr(*while_node->condition);
-    required_inputs.in.insert(visitor.inputs.begin(), visitor.inputs.end());
+    insert_read_names(*while_node->flat_condition, required_inputs.in);
     new_context.inouts.insert_or_assign(end_node.get(),
                                         DfgNodeInout{.inputs = required_inputs, .outputs = context.outputs});
 
+    count_analysis_event(&AnalysisCounters::loop_body_analyses);
     analyse_dfg_impl(new_context);
     auto local = new_context.inouts[dfg_ptr_for_cfg(context.dfg, *while_node->body).get()];
     wl = init_wl;
-    local.inputs.in.insert(visitor.inputs.begin(), visitor.inputs.end());
+    insert_read_names(*while_node->flat_condition, local.inputs.in);
     vis = context.visited;
     new_context.inouts.insert_or_assign(end_node.get(), local);
+    count_analysis_event(&AnalysisCounters::loop_body_analyses);
     analyse_dfg_impl(new_context);
     local = new_context.inouts[dfg_ptr_for_cfg(context.dfg, *while_node->body).get()];
-    local.inputs.in.insert(visitor.inputs.begin(), visitor.inputs.end());
+    insert_read_names(*while_node->flat_condition, local.inputs.in);
     return local.inputs;
 }
 
 static DfgNodeInputs
 compute_dfg_node_inputs_for_if(const IfCfgNode &if_node, const DfgNodeOutputs &outputs) {
     DfgNodeInputs required_inputs = DfgNodeInputs{.in = outputs.out};
-    InputsReadVisitor visitor;
-    visitor.visit_expr(*if_node.condition);
-    required_inputs.in.insert(visitor.inputs.begin(), visitor.inputs.end());
+    insert_read_names(*if_node.flat_condition, required_inputs.in);
     return required_inputs;
 }
 
@@ -160,7 +171,7 @@ void compute_whole_program_required_outputs(const Program &program, DfgNodeOutpu
 }
 
 static std::shared_ptr<DfgNode>
-next_work_list_node(std::vector<std::shared_ptr<DfgNode>> &work_list, const std::set<DfgNode *> &visited) {
+next_work_list_node(std::pmr::vector<std::shared_ptr<DfgNode>> &work_list, const std::pmr::set<DfgNode *> &visited) {
     if (work_list.empty()) {
         throw std::runtime_error("Work list empty");
     }
@@ -187,10 +198,19 @@ next_work_list_node(std::vector<std::shared_ptr<DfgNode>> &work_list, const std:
 }
 
 static void analyse_dfg_impl(AnalyseDfgContext &context) {
+    // one event per drained worklist, loop bodies get their own nested in this one
+    TraceScope trace{"worklist"};
+    uint64_t pops = 0;
+    uint64_t peak_size = context.work_list.size();
     while (!context.work_list.empty()) {
+        peak_size = std::max<uint64_t>(peak_size, context.work_list.size());
         std::shared_ptr<DfgNode> node = next_work_list_node(context.work_list, context.visited);
+        count_analysis_event(&AnalysisCounters::worklist_pops);
+        trace.arg(0, "pops", ++pops);
+        trace.arg(1, "peak_size", peak_size);
 
         if (context.visited.contains(node.get())) {
+            count_analysis_event(&AnalysisCounters::node_revisits);
             continue;
         }
 
@@ -212,6 +232,14 @@ static void analyse_dfg_impl(AnalyseDfgContext &context) {
                 context.inouts.insert_or_assign(node.get(),
                                                 DfgNodeInout{.inputs = inputs, .outputs = required_outputs});
             } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileCfgNode>>) {
+                if (cfg_node->folded == ConstantCondition::AlwaysFalse) {
+                    // never entered, so only the condition is left of it
+                    DfgNodeInputs inputs = DfgNodeInputs{.in = required_outputs.out};
+                    insert_read_names(*cfg_node->flat_condition, inputs.in);
+                    context.inouts.insert_or_assign(node.get(),
+                                                    DfgNodeInout{.inputs = inputs, .outputs = required_outputs});
+                    return;
+                }
                 AnalyseDfgContext while_context = context;
                 while_context.outputs = required_outputs;
                 DfgNodeInputs inputs = compute_dfg_node_inputs_for_while(
@@ -251,17 +279,23 @@ static void analyse_dfg_impl(AnalyseDfgContext &context) {
     }
 }
 
-void analyse_dfg(const Dfg &dfg, const DfgNodeOutputs &whole_program_outputs, DfgNodeUnusedAssignments &unused_assignments) {
+static void analyse_dfg_from_exit(const Dfg &dfg, const DfgNodeOutputs &whole_program_outputs,
+                                  const DfgNodeInputs &exit_inputs, const bool exit_visited,
+                                  DfgNodeUnusedAssignments &unused_assignments,
+                                  std::pmr::map<DfgNode *, DfgNodeInout> &inouts) {
     const std::shared_ptr<DfgNode> end_node = find_end_node(dfg);
-    std::vector<std::shared_ptr<DfgNode>> work_list;
-    std::set<DfgNode *> visited;
-    std::map<DfgNode *, DfgNodeInout> inouts;
+    std::pmr::memory_resource *memory = inouts.get_allocator().resource();
+    std::pmr::vector<std::shared_ptr<DfgNode>> work_list{memory};
+    std::pmr::set<DfgNode *> visited{memory};
 
     for (const auto &in_node: end_node->in_nodes) {
         work_list.push_back(in_node.lock());
     }
+    if (exit_visited) {
+        visited.insert(end_node.get());
+    }
     inouts.insert({end_node.get(), DfgNodeInout{
-            .inputs = DfgNodeInputs{.in = whole_program_outputs.out},
+            .inputs = exit_inputs,
             .outputs = DfgNodeOutputs(),
     }});
 
@@ -275,4 +309,29 @@ void analyse_dfg(const Dfg &dfg, const DfgNodeOutputs &whole_program_outputs, Df
     };
 
     analyse_dfg_impl(context);
-}
\ No newline at end of file
+}
+
+void analyse_dfg(const Dfg &dfg, const DfgNodeOutputs &whole_program_outputs, DfgNodeUnusedAssignments &unused_assignments,
+                 std::pmr::memory_resource *memory) {
+    TraceScope trace{"analyse_dfg"};
+    std::pmr::map<DfgNode *, DfgNodeInout> inouts{memory};
+    analyse_dfg_from_exit(dfg, whole_program_outputs, DfgNodeInputs{.in = whole_program_outputs.out}, false,
+                          unused_assignments, inouts);
+}
+
+void analyse_dfg_inouts(const Dfg &dfg, const DfgNodeOutputs &whole_program_outputs,
+                        DfgNodeUnusedAssignments &unused_assignments, DfgInouts &inouts) {
+    TraceScope trace{"analyse_dfg_inouts"};
+    analyse_dfg_from_exit(dfg, whole_program_outputs, DfgNodeInputs{.in = whole_program_outputs.out}, false,
+                          unused_assignments, inouts);
+}
+
+void analyse_dfg_region(const Dfg &dfg, const DfgNodeOutputs &whole_program_outputs, const DfgNodeInputs &live_out,
+                        const bool successor_analysed, DfgNodeUnusedAssignments &unused_assignments,
+                        DfgNodeInputs &live_in, std::pmr::memory_resource *memory) {
+    TraceScope trace{"analyse_dfg_region"};
+    std::pmr::map<DfgNode *, DfgNodeInout> inouts{memory};
+    analyse_dfg_from_exit(dfg, whole_program_outputs, live_out, successor_analysed, unused_assignments, inouts);
+    // the entry node is always the first one built, see build_dfg_nodes
+    live_in = inouts[dfg.nodes.front().get()].inputs;
+}
@@ -5,6 +5,8 @@
 #ifndef DFA_SAMPLE_DFG_ANALYSIS_HPP
 #define DFA_SAMPLE_DFG_ANALYSIS_HPP
 
+#include <map>
+#include <memory_resource>
 #include <set>
 #include "ast.hpp"
 #include "cfg.hpp"
@@ -27,7 +29,24 @@ struct DfgNodeInout {
     DfgNodeOutputs outputs;
 };
 
-void analyse_dfg(const Dfg& dfg, const DfgNodeOutputs& whole_program_outputs, DfgNodeUnusedAssignments& unused_assignments);
+using DfgInouts = std::pmr::map<DfgNode*, DfgNodeInout>;
+
+// The worklists, visited sets and per-node state of the analysis are allocated from `memory`.
+void analyse_dfg(const Dfg& dfg, const DfgNodeOutputs& whole_program_outputs, DfgNodeUnusedAssignments& unused_assignments,
+                 std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+// The same, also leaving in `inouts` what each node requires and what is required after it, as the analysis
+// left them: loop bodies with their second pass.
+void analyse_dfg_inouts(const Dfg& dfg, const DfgNodeOutputs& whole_program_outputs,
+                        DfgNodeUnusedAssignments& unused_assignments, DfgInouts& inouts);
+// Analyses a DFG built from a single top-level statement of a bigger program, as if it was embedded in it:
+// `live_out` is what the statements after it require (or the whole program outputs for the last one), and
+// `successor_analysed` tells whether that requirement comes from an already analysed statement rather than the
+// program exit. Produces the same unused assignments for the statement as analyse_dfg over the whole program,
+// and stores the variables the statement requires in `live_in`.
+void analyse_dfg_region(const Dfg& dfg, const DfgNodeOutputs& whole_program_outputs, const DfgNodeInputs& live_out,
+                        bool successor_analysed, DfgNodeUnusedAssignments& unused_assignments,
+                        DfgNodeInputs& live_in,
+                        std::pmr::memory_resource* memory = std::pmr::get_default_resource());
 void compute_whole_program_required_outputs(const Program& program, DfgNodeOutputs& whole_program_outputs);
 
 #endif //DFA_SAMPLE_DFG_ANALYSIS_HPP
@@ -0,0 +1,63 @@
+#include "flat_expr.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include "memory.hpp"
+#include "visitor.hpp"
+
+struct ExprLowering : public StaticAstVisitor<ExprLowering> {
+    FlatExpr &out;
+
+    explicit ExprLowering(FlatExpr &out) : out(out) {
+    }
+
+    void visit_name(const Name &name) {
+        out.ops.push_back(FlatOp{.kind = FlatOpKind::Name, .name = name.name[0], .value = 0});
+    }
+
+    void visit_constant(const Constant &constant) {
+        out.ops.push_back(FlatOp{.kind = FlatOpKind::Constant, .name = 0, .value = constant.value});
+    }
+
+    void visit_binary_expr(const BinaryExpr &binary_expr) {
+        walk_binary_expr(binary_expr);
+        out.ops.push_back(FlatOp{.kind = flat_op_kind(binary_expr.op), .name = 0, .value = 0});
+    }
+};
+
+FlatOpKind flat_op_kind(const BinaryOp op) {
+    switch (op) {
+        case BinaryOp::Add:
+            return FlatOpKind::Add;
+        case BinaryOp::Sub:
+            return FlatOpKind::Sub;
+        case BinaryOp::Mul:
+            return FlatOpKind::Mul;
+        case BinaryOp::Div:
+            return FlatOpKind::Div;
+        case BinaryOp::Lt:
+            return FlatOpKind::Lt;
+        case BinaryOp::Gt:
+            return FlatOpKind::Gt;
+    }
+    throw std::runtime_error("Unknown binary operator");
+}
+
+FlatExpr FlatExpr::lower(const Expr &expr) {
+    FlatExpr flat;
+    ExprLowering{flat}.visit_expr(expr);
+    flat.for_each_name([&](const char name) {
+        flat.reads.push_back(name);
+    });
+    std::ranges::sort(flat.reads);
+    const auto duplicates = std::ranges::unique(flat.reads);
+    flat.reads.erase(duplicates.begin(), duplicates.end());
+    return flat;
+}
+
+std::shared_ptr<const FlatExpr> FlatExprCache::lower(const std::shared_ptr<Expr> &expr) {
+    auto [it, inserted] = lowered.try_emplace(expr.get());
+    if (inserted) {
+        it->second = make_shared_in<FlatExpr>(memory, FlatExpr::lower(*expr));
+    }
+    return it->second;
+}
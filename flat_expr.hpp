@@ -0,0 +1,127 @@
+#ifndef DFA_SAMPLE_FLAT_EXPR_HPP
+#define DFA_SAMPLE_FLAT_EXPR_HPP
+
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include "ast.hpp"
+
+enum class FlatOpKind : uint8_t {
+    // push the value of a variable
+    Name,
+    // push a constant
+    Constant,
+    // pop two values, push the result
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Lt,
+    Gt,
+};
+
+struct FlatOp {
+    FlatOpKind kind;
+    // first character of the name, which is all the analysis tells variables apart by
+    char name;
+    int32_t value;
+};
+
+// An expression in post-order, operands before the operators using them. Parentheses leave no trace, and the
+// variables read are the Name ops, in a single scan.
+struct FlatExpr {
+    std::vector<FlatOp> ops;
+    // the names of the Name ops, each once, sorted
+    std::vector<char> reads;
+
+    static FlatExpr lower(const Expr &expr);
+
+    template<typename F>
+    void for_each_name(F &&f) const {
+        for (const FlatOp &op: ops) {
+            if (op.kind == FlatOpKind::Name) {
+                f(op.name);
+            }
+        }
+    }
+
+    // Runs the expression on a stack machine, with `value_of(name)` giving the value of each variable read.
+    // Arithmetic wraps around, and comparisons give 0 or 1. Returns std::nullopt on a division by zero.
+    template<typename F>
+    [[nodiscard]] std::optional<int32_t> evaluate(F &&value_of, std::vector<int32_t> &stack) const;
+};
+
+// Lowers every distinct expression node once, so that with hash-consed expressions (see ExprInterner) each
+// unique expression is only lowered, and its reads collected, a single time.
+class FlatExprCache {
+    std::unordered_map<const Expr *, std::shared_ptr<const FlatExpr>> lowered;
+    std::pmr::memory_resource *memory;
+
+public:
+    explicit FlatExprCache(std::pmr::memory_resource *memory) : memory(memory) {
+    }
+
+    std::shared_ptr<const FlatExpr> lower(const std::shared_ptr<Expr> &expr);
+};
+
+FlatOpKind flat_op_kind(BinaryOp op);
+
+// Applies the integer semantics of a binary operator, for FlatExpr::evaluate. Usable in constant expressions.
+constexpr int32_t apply_binary_op(const FlatOpKind kind, const int32_t lhs, const int32_t rhs) {
+    const auto l = static_cast<uint32_t>(lhs);
+    const auto r = static_cast<uint32_t>(rhs);
+    switch (kind) {
+        case FlatOpKind::Add:
+            return static_cast<int32_t>(l + r);
+        case FlatOpKind::Sub:
+            return static_cast<int32_t>(l - r);
+        case FlatOpKind::Mul:
+            return static_cast<int32_t>(l * r);
+        case FlatOpKind::Div:
+            if (rhs == 0) {
+                throw std::runtime_error("Division by zero");
+            }
+            // the one quotient that does not fit
+            if (lhs == std::numeric_limits<int32_t>::min() && rhs == -1) {
+                return lhs;
+            }
+            return lhs / rhs;
+        case FlatOpKind::Lt:
+            return lhs < rhs;
+        case FlatOpKind::Gt:
+            return lhs > rhs;
+        default:
+            throw std::runtime_error("Not a binary operator");
+    }
+}
+
+template<typename F>
+std::optional<int32_t> FlatExpr::evaluate(F &&value_of, std::vector<int32_t> &stack) const {
+    stack.clear();
+    for (const FlatOp &op: ops) {
+        switch (op.kind) {
+            case FlatOpKind::Name:
+                stack.push_back(value_of(op.name));
+                break;
+            case FlatOpKind::Constant:
+                stack.push_back(op.value);
+                break;
+            default: {
+                const int32_t rhs = stack.back();
+                stack.pop_back();
+                if (op.kind == FlatOpKind::Div && rhs == 0) {
+                    return std::nullopt;
+                }
+                stack.back() = apply_binary_op(op.kind, stack.back(), rhs);
+                break;
+            }
+        }
+    }
+    return stack.back();
+}
+
+#endif //DFA_SAMPLE_FLAT_EXPR_HPP
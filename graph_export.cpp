@@ -0,0 +1,291 @@
+#include "graph_export.hpp"
+#include <string>
+#include <unordered_map>
+#include "trace.hpp"
+
+bool parse_graph_format(const std::string_view name, GraphFormat &format) {
+    if (name == "dot") {
+        format = GraphFormat::Dot;
+    } else if (name == "json") {
+        format = GraphFormat::Json;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+struct ExprFormatter : public StaticAstVisitor<ExprFormatter> {
+    std::string &out;
+
+    explicit ExprFormatter(std::string &out) : out(out) {
+    }
+
+    void visit_name(const Name &name) {
+        out += name.name;
+    }
+
+    void visit_constant(const Constant &constant) {
+        out += std::to_string(constant.value);
+    }
+
+    void visit_paren_expr(const ParenExpr &paren_expr) {
+        out += '(';
+        walk_paren_expr(paren_expr);
+        out += ')';
+    }
+
+    void visit_binary_expr(const BinaryExpr &binary_expr) {
+        static constexpr const char *operators[] = {" + ", " - ", " * ", " / ", " < ", " > "};
+        visit_expr(*binary_expr.lhs);
+        out += operators[binary_expr.op];
+        visit_expr(*binary_expr.rhs);
+    }
+};
+
+static const char *folded_suffix(const ConstantCondition folded) {
+    switch (folded) {
+        case ConstantCondition::Unknown:
+            return "";
+        case ConstantCondition::AlwaysTrue:
+            return " (always true)";
+        case ConstantCondition::AlwaysFalse:
+            return " (always false)";
+    }
+    return "";
+}
+
+// The kind of `node`, and one line per assignment or for its condition.
+static const char *describe_node(const CfgNode &node, std::vector<std::string> &lines) {
+    lines.clear();
+    return std::visit([&]<typename T0>(T0 &&cfg_node) -> const char * {
+        using T = std::decay_t<T0>;
+        if constexpr (std::is_same_v<T, BasicCfgBlock>) {
+            for (const auto &assignment: cfg_node.assignments) {
+                std::string &line = lines.emplace_back(assignment->name.name);
+                line += " = ";
+                ExprFormatter{line}.visit_expr(*assignment->expr);
+            }
+            return "basic_block";
+        } else if constexpr (std::is_same_v<T, IfCfgNode>) {
+            std::string &line = lines.emplace_back("if ");
+            ExprFormatter{line}.visit_expr(*cfg_node.condition);
+            line += folded_suffix(cfg_node.folded);
+            return "if";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileCfgNode>>) {
+            std::string &line = lines.emplace_back("while ");
+            ExprFormatter{line}.visit_expr(*cfg_node->condition);
+            line += folded_suffix(cfg_node->folded);
+            return "while";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileRetDummyCfgNode>>) {
+            return "while_ret_dummy";
+        } else if constexpr (std::is_same_v<T, ExitCfgNode>) {
+            return "exit";
+        } else {
+            static_assert(false, "non-exhaustive visitor!");
+        }
+    }, node.node);
+}
+
+// Writes nodes and edges in either format, one at a time. In JSON, the edges are written after all the nodes,
+// so they are kept until then.
+class GraphWriter {
+    GraphFormat format;
+    ReportBuffer &out;
+    struct Edge {
+        size_t from;
+        size_t to;
+        const char *label;
+    };
+    std::vector<Edge> edges;
+    bool first_node = true;
+
+    void append_set(const std::set<char> &set) {
+        if (format == GraphFormat::Dot) {
+            for (const char name: set) {
+                out.append(' ');
+                out.append(name);
+            }
+            return;
+        }
+        out.append('[');
+        for (auto it = set.begin(); it != set.end(); ++it) {
+            if (it != set.begin()) {
+                out.append(',');
+            }
+            out.append_json_string(std::string_view{&*it, 1});
+        }
+        out.append(']');
+    }
+
+public:
+    GraphWriter(const GraphFormat format, ReportBuffer &out, const std::string_view name) : format(format), out(out) {
+        if (format == GraphFormat::Dot) {
+            out.append("digraph ");
+            out.append(name);
+            out.append(" {\n  node [shape=box, fontname=\"monospace\"];\n");
+        } else {
+            out.append("{\"graph\":");
+            out.append_json_string(name);
+            out.append(",\"nodes\":[");
+        }
+    }
+
+    void node(const size_t id, const char *kind, const std::vector<std::string> &lines,
+              const DfgNodeInout *inout) {
+        if (format == GraphFormat::Dot) {
+            // names, numbers and operators need no escaping in a DOT string
+            out.append("  n");
+            out.append_number(id);
+            out.append(" [label=\"");
+            out.append(kind);
+            for (const std::string &line: lines) {
+                out.append("\\l");
+                out.append(line);
+            }
+            if (inout != nullptr) {
+                out.append("\\lin:");
+                append_set(inout->inputs.in);
+                out.append("\\lout:");
+                append_set(inout->outputs.out);
+            }
+            out.append("\\l\"];\n");
+            return;
+        }
+        if (!first_node) {
+            out.append(',');
+        }
+        first_node = false;
+        out.append("{\"id\":");
+        out.append_number(id);
+        out.append(",\"kind\":");
+        out.append_json_string(kind);
+        out.append(",\"lines\":[");
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (i != 0) {
+                out.append(',');
+            }
+            out.append_json_string(lines[i]);
+        }
+        out.append(']');
+        if (inout != nullptr) {
+            out.append(",\"live_in\":");
+            append_set(inout->inputs.in);
+            out.append(",\"live_out\":");
+            append_set(inout->outputs.out);
+        }
+        out.append('}');
+    }
+
+    void edge(const size_t from, const size_t to, const char *label) {
+        if (format == GraphFormat::Json) {
+            edges.push_back(Edge{.from = from, .to = to, .label = label});
+            return;
+        }
+        out.append("  n");
+        out.append_number(from);
+        out.append(" -> n");
+        out.append_number(to);
+        if (label != nullptr) {
+            out.append(" [label=\"");
+            out.append(label);
+            out.append("\"]");
+        }
+        out.append(";\n");
+    }
+
+    void end() {
+        if (format == GraphFormat::Dot) {
+            out.append("}\n");
+            return;
+        }
+        out.append("],\"edges\":[");
+        for (size_t i = 0; i < edges.size(); i++) {
+            if (i != 0) {
+                out.append(',');
+            }
+            out.append("{\"from\":");
+            out.append_number(edges[i].from);
+            out.append(",\"to\":");
+            out.append_number(edges[i].to);
+            if (edges[i].label != nullptr) {
+                out.append(",\"label\":");
+                out.append_json_string(edges[i].label);
+            }
+            out.append('}');
+        }
+        out.append("]}\n");
+    }
+};
+
+// The links out of `node`, with their labels.
+static std::vector<std::pair<const CfgNode *, const char *>> cfg_successors(const CfgNode &node) {
+    return std::visit([&]<typename T0>(T0 &&cfg_node) -> std::vector<std::pair<const CfgNode *, const char *>> {
+        using T = std::decay_t<T0>;
+        if constexpr (std::is_same_v<T, BasicCfgBlock>) {
+            return {{node.next.get(), "next"}};
+        } else if constexpr (std::is_same_v<T, IfCfgNode>) {
+            return {{cfg_node.then_branch.get(), "then"}, {node.next.get(), "else"}};
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileCfgNode>>) {
+            return {{cfg_node->body.get(), "body"}, {node.next.get(), "exit"}};
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileRetDummyCfgNode>>) {
+            return {{cfg_node->while_node.value().lock().get(), "loop"}};
+        } else if constexpr (std::is_same_v<T, ExitCfgNode>) {
+            return {};
+        } else {
+            static_assert(false, "non-exhaustive visitor!");
+        }
+    }, node.node);
+}
+
+void export_cfg(const Cfg &cfg, const GraphFormat format, ReportBuffer &out) {
+    TraceScope trace{"export_cfg"};
+    std::unordered_map<const CfgNode *, size_t> ids;
+    std::vector<const CfgNode *> stack{cfg.entry.get()};
+    ids.emplace(cfg.entry.get(), 0);
+    GraphWriter writer{format, out, "cfg"};
+    std::vector<std::string> lines;
+    std::vector<const CfgNode *> discovered;
+    while (!stack.empty()) {
+        const CfgNode *node = stack.back();
+        stack.pop_back();
+        const size_t id = ids.at(node);
+        writer.node(id, describe_node(*node, lines), lines, nullptr);
+        discovered.clear();
+        for (const auto &[successor, label]: cfg_successors(*node)) {
+            const auto [it, inserted] = ids.emplace(successor, ids.size());
+            if (inserted) {
+                discovered.push_back(successor);
+            }
+            writer.edge(id, it->second, label);
+        }
+        // pushed backwards, so that the first successor is walked first
+        stack.insert(stack.end(), discovered.rbegin(), discovered.rend());
+    }
+    writer.end();
+}
+
+void export_dfg(const Dfg &dfg, const GraphFormat format, ReportBuffer &out, const DfgInouts *inouts) {
+    TraceScope trace{"export_dfg"};
+    std::unordered_map<const DfgNode *, size_t> ids;
+    for (size_t i = 0; i < dfg.nodes.size(); i++) {
+        ids.emplace(dfg.nodes[i].get(), i);
+    }
+    GraphWriter writer{format, out, "dfg"};
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < dfg.nodes.size(); i++) {
+        const DfgNode &node = *dfg.nodes[i];
+        const DfgNodeInout *inout = nullptr;
+        if (inouts != nullptr) {
+            if (const auto it = inouts->find(dfg.nodes[i].get()); it != inouts->end()) {
+                inout = &it->second;
+            }
+        }
+        writer.node(i, describe_node(*node.cfg_node, lines), lines, inout);
+    }
+    for (size_t i = 0; i < dfg.nodes.size(); i++) {
+        for (const auto &out_node: dfg.nodes[i]->out_nodes) {
+            writer.edge(i, ids.at(out_node.lock().get()), nullptr);
+        }
+    }
+    writer.end();
+}
@@ -0,0 +1,27 @@
+#ifndef DFA_SAMPLE_GRAPH_EXPORT_HPP
+#define DFA_SAMPLE_GRAPH_EXPORT_HPP
+
+#include <string_view>
+#include "cfg.hpp"
+#include "dfg.hpp"
+#include "dfg_analysis.hpp"
+#include "reporter.hpp"
+
+enum class GraphFormat {
+    Dot,
+    Json,
+};
+
+bool parse_graph_format(std::string_view name, GraphFormat &format);
+
+// Writes every node of `cfg` reachable from the entry once, numbered in the order a depth-first walk from the
+// entry finds them, and every link between them once: `next`, `then` and `else` from an if, `body` and `exit`
+// from a while, and `loop` from the end of a loop body back to its while. The output is linear in the size of
+// the graph, unlike dbg_cfg, which prints whole subgraphs from every node.
+void export_cfg(const Cfg &cfg, GraphFormat format, ReportBuffer &out);
+
+// Writes every node of `dfg` once, numbered by their index in `dfg.nodes`, and every edge to an out node once.
+// With `inouts` from analyse_dfg_inouts, the nodes also show what they require and what is required after them.
+void export_dfg(const Dfg &dfg, GraphFormat format, ReportBuffer &out, const DfgInouts *inouts = nullptr);
+
+#endif //DFA_SAMPLE_GRAPH_EXPORT_HPP
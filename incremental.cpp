@@ -0,0 +1,285 @@
+#include "incremental.hpp"
+#include <algorithm>
+
+// The analysis rejects assignments to names longer than one character, but only once it gets to them. Check
+// upfront, so that an edit is either applied completely or not at all.
+struct AssignedNamesCheck : public StaticAstVisitor<AssignedNamesCheck> {
+    void visit_assignment_stmt(const AssignmentStmt &assignment_stmt) {
+        if (assignment_stmt.lhs.name.length() != 1) {
+            throw std::runtime_error("Invalid name length");
+        }
+        walk_assignment_stmt(assignment_stmt);
+    }
+};
+
+IncrementalAnalysis::IncrementalAnalysis(const std::string_view src) {
+    apply_edit(TextEdit{.start = 0, .end = 0, .replacement = std::string(src)});
+}
+
+size_t IncrementalAnalysis::statement_end(const size_t index) const {
+    return statements[index]->start + statements[index]->text.size();
+}
+
+void IncrementalAnalysis::append_source(std::string &out, size_t from, const size_t to) const {
+    if (from >= to) {
+        return;
+    }
+    if (from < leading.size()) {
+        out.append(leading, from, std::min(to, leading.size()) - from);
+        from = leading.size();
+    }
+    auto it = std::ranges::partition_point(statements, [&](const auto &statement) {
+        return statement->start + statement->text.size() <= from;
+    });
+    for (; it != statements.end() && from < to; ++it) {
+        const IncrementalStatement &statement = **it;
+        const size_t end = std::min(to, statement.start + statement.text.size());
+        out.append(statement.text, from - statement.start, end - from);
+        from = end;
+    }
+}
+
+void IncrementalAnalysis::apply_edit(const TextEdit &edit) {
+    apply_edits({edit});
+}
+
+void IncrementalAnalysis::apply_edits(std::vector<TextEdit> edits) {
+    std::ranges::sort(edits, {}, &TextEdit::start);
+    for (size_t i = 0; i < edits.size(); i++) {
+        if (edits[i].start > edits[i].end || edits[i].end > size) {
+            throw std::runtime_error("Edit out of range");
+        }
+        if (i > 0 && edits[i].start < edits[i - 1].end) {
+            throw std::runtime_error("Overlapping edits");
+        }
+    }
+    last_reparsed = 0;
+    try {
+        // from the last edit to the first, so that the offsets of the ones left stay valid
+        for (auto it = edits.rbegin(); it != edits.rend(); ++it) {
+            replace_statements(*it);
+        }
+    } catch (const std::runtime_error &) {
+        update_analysis();
+        throw;
+    }
+    update_analysis();
+}
+
+void IncrementalAnalysis::replace_statements(const TextEdit &edit) {
+    const size_t n = statements.size();
+    const auto statements_starting_before = [&](const size_t offset) -> size_t {
+        return std::ranges::partition_point(statements, [&](const auto &statement) {
+            return statement->start < offset;
+        }) - statements.begin();
+    };
+    // the statement before the edit is reparsed as well, since its end depends on the first character after it
+    const size_t first = std::max<size_t>(statements_starting_before(edit.start), 1) - 1;
+    const size_t last_touched = std::max(first, std::max<size_t>(statements_starting_before(edit.end), 1) - 1);
+    const size_t window_begin = first == 0 ? 0 : statements[first]->start;
+    const auto delta = static_cast<ptrdiff_t>(edit.replacement.size()) - static_cast<ptrdiff_t>(edit.end - edit.start);
+
+    // Parse the edited text until a statement starts where an untouched one used to start (shifted by the
+    // edit). The window of old statements after the edit grows until that happens, or until the end of input.
+    std::string window;
+    std::vector<size_t> boundaries;
+    size_t resync = n;
+    size_t parsed_end = 0;
+    for (size_t window_statements = 1;; window_statements *= 2) {
+        const size_t window_end_index = std::min(n, last_touched + 1 + window_statements);
+        const bool window_at_eof = window_end_index == n;
+        window.clear();
+        append_source(window, window_begin, edit.start);
+        window += edit.replacement;
+        append_source(window, edit.end, n == 0 ? size : statement_end(window_end_index - 1));
+
+        boundaries.clear();
+        resync = n;
+        parsed_end = window.size();
+        try {
+            ParserState state{Lexer{window}};
+            state.lexer.skip_whitespace();
+            size_t candidate = last_touched + 1;
+            while (!state.lexer.eof()) {
+                const auto old_offset = static_cast<ptrdiff_t>(window_begin + state.lexer.pos) - delta;
+                while (candidate < window_end_index
+                       && static_cast<ptrdiff_t>(statements[candidate]->start) < old_offset) {
+                    candidate++;
+                }
+                if (candidate < window_end_index
+                    && static_cast<ptrdiff_t>(statements[candidate]->start) == old_offset) {
+                    resync = candidate;
+                    parsed_end = state.lexer.pos;
+                    break;
+                }
+                boundaries.push_back(state.lexer.pos);
+                parse_statement(state);
+                state.lexer.skip_whitespace();
+            }
+        } catch (const std::runtime_error &) {
+            if (window_at_eof) {
+                throw;
+            }
+            continue;
+        }
+        if (resync != n || window_at_eof) {
+            break;
+        }
+    }
+
+    std::vector<std::unique_ptr<IncrementalStatement>> parsed;
+    for (size_t i = 0; i < boundaries.size(); i++) {
+        const size_t end = i + 1 < boundaries.size() ? boundaries[i + 1] : parsed_end;
+        auto statement = std::make_unique<IncrementalStatement>();
+        statement->text = window.substr(boundaries[i], end - boundaries[i]);
+        statement->start = window_begin + boundaries[i];
+        ParserState state{Lexer{statement->text}};
+        statement->program.statements.statements.push_back(parse_statement(state));
+        // the rest of the text is whitespace, with line breaks that count for the statements after it
+        state.lexer.skip_whitespace();
+        statement->lines = std::move(state.lexer.lines);
+        AssignedNamesCheck check;
+        check.visit_program(statement->program);
+        statement->cfg = build_cfg(statement->program);
+        compute_whole_program_required_outputs(statement->program, statement->names);
+        parsed.push_back(std::move(statement));
+    }
+
+    if (first == 0) {
+        leading = window.substr(0, boundaries.empty() ? parsed_end : boundaries.front());
+    }
+    for (size_t i = first; i < resync; i++) {
+        for (const char name: statements[i]->names.out) {
+            name_counts[static_cast<unsigned char>(name)]--;
+        }
+    }
+    for (const auto &statement: parsed) {
+        for (const char name: statement->names.out) {
+            name_counts[static_cast<unsigned char>(name)]++;
+        }
+    }
+    for (size_t i = resync; i < n; i++) {
+        statements[i]->start += delta;
+    }
+    size += delta;
+    const size_t parsed_count = parsed.size();
+    last_reparsed += parsed_count;
+    statements.erase(statements.begin() + static_cast<ptrdiff_t>(first),
+                     statements.begin() + static_cast<ptrdiff_t>(resync));
+    statements.insert(statements.begin() + static_cast<ptrdiff_t>(first),
+                      std::make_move_iterator(parsed.begin()), std::make_move_iterator(parsed.end()));
+    if (parsed_count == 0 && first < statements.size()) {
+        // the statement now in place of the removed ones may start from other constants, so refold it too
+        statements[first]->needs_fold = true;
+    }
+}
+
+void IncrementalAnalysis::update_analysis() {
+    const auto needs_fold = [](const auto &statement) {
+        return statement->needs_fold;
+    };
+    const size_t first = std::ranges::find_if(statements, needs_fold) - statements.begin();
+    const size_t reparsed_end =
+            statements.rend() - std::ranges::find_if(statements.rbegin(), statements.rend(), needs_fold);
+
+    // Constants flow forwards: fold the branches of the new statements, and of the ones after them for as long
+    // as the constants they start with keep changing. The DFGs of those are built (again) with the new folds.
+    size_t refolded_end = first;
+    for (size_t i = first; i < statements.size(); i++) {
+        IncrementalStatement &statement = *statements[i];
+        ConstantState constants = i == 0 ? ConstantState{} : statements[i - 1]->constants_out;
+        if (!statement.needs_fold && constants == statement.constants_in) {
+            if (i >= reparsed_end) {
+                break;
+            }
+            continue;
+        }
+        statement.constants_in = constants;
+        fold_constant_branches(statement.cfg, constants);
+        statement.constants_out = std::move(constants);
+        statement.dfg = build_dfg(statement.cfg);
+        statement.needs_fold = false;
+        statement.needs_analysis = true;
+        refolded_end = i + 1;
+    }
+
+    DfgNodeOutputs outputs;
+    for (size_t c = 0; c < name_counts.size(); c++) {
+        if (name_counts[c] != 0) {
+            outputs.out.insert(static_cast<char>(c));
+        }
+    }
+    // every statement depends on the set of variables in the whole program, so new variables invalidate
+    // everything; removed ones appear nowhere anymore, and the liveness of each variable is found independently of
+    // the others, so what is left of them in the live sets changes no result
+    const bool all_invalid = !std::ranges::includes(whole_program_outputs.out, outputs.out);
+    whole_program_outputs = std::move(outputs);
+
+    last_reanalysed = 0;
+    for (size_t i = all_invalid ? statements.size() : refolded_end; i-- > 0;) {
+        if (!all_invalid && !statements[i]->needs_analysis) {
+            const bool successor_analysed = i + 1 < statements.size();
+            const std::set<char> &live_out = successor_analysed
+                                                 ? statements[i + 1]->live_in.in
+                                                 : whole_program_outputs.out;
+            if (statements[i]->successor_analysed == successor_analysed && statements[i]->live_out.in == live_out) {
+                if (i < first) {
+                    break;
+                }
+                continue;
+            }
+        }
+        analyse_statement(i);
+    }
+}
+
+void IncrementalAnalysis::analyse_statement(const size_t index) {
+    IncrementalStatement &statement = *statements[index];
+    statement.successor_analysed = index + 1 < statements.size();
+    statement.live_out.in = statement.successor_analysed
+                                ? statements[index + 1]->live_in.in
+                                : whole_program_outputs.out;
+
+    DfgNodeUnusedAssignments unused_assignments;
+    analyse_dfg_region(statement.dfg, whole_program_outputs, statement.live_out, statement.successor_analysed,
+                       unused_assignments, statement.live_in);
+    std::ranges::sort(unused_assignments.assignments,
+                      [](const auto &a, const auto &b) {
+                          return a->span.start < b->span.start;
+                      });
+    statement.unused_assignments = std::move(unused_assignments.assignments);
+    statement.needs_analysis = false;
+    last_reanalysed++;
+}
+
+std::string IncrementalAnalysis::source() const {
+    std::string src;
+    src.reserve(size);
+    append_source(src, 0, size);
+    return src;
+}
+
+std::vector<UnusedAssignment> IncrementalAnalysis::unused_assignments() const {
+    std::vector<UnusedAssignment> result;
+    // lines before the current statement, and where the line it starts on starts
+    size_t lines_before = LineIndex::build(leading).line_starts.size() - 1;
+    size_t line_start = leading.rfind('\n') == std::string::npos ? 0 : leading.rfind('\n') + 1;
+    for (const auto &statement: statements) {
+        for (const auto &assignment: statement->unused_assignments) {
+            const auto [line, column] = statement->lines.locate(assignment->span.start);
+            result.push_back(UnusedAssignment{
+                .name = assignment->name.name,
+                .start = statement->start + assignment->span.start,
+                .end = statement->start + assignment->span.end,
+                .line = lines_before + line,
+                .column = line == 1 ? statement->start + assignment->span.start - line_start + 1 : column,
+            });
+        }
+        const auto &line_starts = statement->lines.line_starts;
+        lines_before += line_starts.size() - 1;
+        if (line_starts.size() > 1) {
+            line_start = statement->start + line_starts.back();
+        }
+    }
+    return result;
+}
@@ -0,0 +1,97 @@
+#ifndef DFA_SAMPLE_INCREMENTAL_HPP
+#define DFA_SAMPLE_INCREMENTAL_HPP
+
+#include <array>
+#include "analysis.hpp"
+#include "parse.hpp"
+#include "cfg.hpp"
+#include "constant_propagation.hpp"
+#include "dfg.hpp"
+#include "dfg_analysis.hpp"
+
+struct TextEdit {
+    // byte range [start, end) of the current source that is replaced
+    size_t start;
+    size_t end;
+    std::string replacement;
+};
+
+// One top-level statement, with everything derived from it. The AST points into `text`, so statements are only
+// ever handled through pointers and never move in memory.
+struct IncrementalStatement {
+    // the statement and the whitespace after it, up to the next statement
+    std::string text;
+    // offset of `text` in the whole source; all the spans below are relative to it
+    size_t start;
+    LineIndex lines;
+    Program program;
+    Cfg cfg;
+    Dfg dfg;
+    DfgNodeOutputs names;
+
+    // the constants the previous statements leave, which the branches of `cfg` were folded with, and the
+    // constants after the statement
+    ConstantState constants_in;
+    ConstantState constants_out;
+
+    // what the statement was last analysed with, and the results
+    DfgNodeInputs live_out;
+    bool successor_analysed = false;
+    DfgNodeInputs live_in;
+    std::vector<std::shared_ptr<AssignmentCfgNode>> unused_assignments;
+
+    // set from when the statement is parsed until its branches are folded and its DFG built, and from then until
+    // it is analysed with that DFG
+    bool needs_fold = true;
+    bool needs_analysis = false;
+};
+
+// Keeps the analysis of a program around so that it can be updated after an edit, by reparsing only the
+// top-level statements touched by it, and re-analysing statements backwards from there for as long as the
+// variables they require keep changing.
+//
+// The unit of all of this is the top-level statement, not the subtree or the CFG node an edit lands in: an edit
+// inside an if or a while reparses, refolds and re-analyses the whole statement, everything nested in it
+// included. The work for an edit is proportional to the size of the top-level statements it touches, so a program
+// that is mostly one large loop is redone almost completely on every edit.
+class IncrementalAnalysis {
+    // whitespace before the first statement
+    std::string leading;
+    std::vector<std::unique_ptr<IncrementalStatement>> statements;
+    size_t size = 0;
+    // number of statements each variable appears in
+    std::array<size_t, 256> name_counts{};
+    DfgNodeOutputs whole_program_outputs;
+
+public:
+    size_t last_reparsed = 0;
+    size_t last_reanalysed = 0;
+
+    explicit IncrementalAnalysis(std::string_view src);
+
+    void apply_edit(const TextEdit &edit);
+
+    // Applies edits that do not overlap, with offsets into the current source, and then updates the analysis once
+    // for all of them. If one of them fails to parse, the ones after it in the source are kept.
+    void apply_edits(std::vector<TextEdit> edits);
+
+    [[nodiscard]] std::string source() const;
+
+    // sorted by span start, with spans into the current source; names are valid until the next edit
+    [[nodiscard]] std::vector<UnusedAssignment> unused_assignments() const;
+
+private:
+    [[nodiscard]] size_t statement_end(size_t index) const;
+
+    void append_source(std::string &out, size_t from, size_t to) const;
+
+    // Reparses the top-level statements touched by `edit`, as a whole, and puts them in place of the old ones,
+    // leaving the analysis to update_analysis.
+    void replace_statements(const TextEdit &edit);
+
+    void update_analysis();
+
+    void analyse_statement(size_t index);
+};
+
+#endif //DFA_SAMPLE_INCREMENTAL_HPP
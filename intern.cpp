@@ -0,0 +1,56 @@
+#include "intern.hpp"
+#include "memory.hpp"
+
+size_t ExprInterner::KeyHash::operator()(const Key &key) const {
+    size_t hash = key.index;
+    const auto combine = [&](const size_t value) {
+        hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    };
+    combine(std::hash<int>{}(key.value));
+    combine(key.op);
+    combine(std::hash<std::string_view>{}(key.name));
+    combine(std::hash<const Expr *>{}(key.lhs));
+    combine(std::hash<const Expr *>{}(key.rhs));
+    return hash;
+}
+
+std::shared_ptr<Expr> ExprInterner::intern(Expr expr, std::pmr::memory_resource *memory) {
+    Key key{.index = expr.data.index(), .value = 0, .op = Add, .name = {}, .lhs = nullptr, .rhs = nullptr};
+    std::visit([&]<typename T0>(T0 &&node) {
+        using T = std::decay_t<T0>;
+        if constexpr (std::is_same_v<T, Name>) {
+            key.name = node.name;
+        } else if constexpr (std::is_same_v<T, Constant>) {
+            key.value = node.value;
+        } else if constexpr (std::is_same_v<T, ParenExpr>) {
+            key.lhs = node.expr.get();
+        } else if constexpr (std::is_same_v<T, BinaryExpr>) {
+            key.op = node.op;
+            key.lhs = node.lhs.get();
+            key.rhs = node.rhs.get();
+        } else {
+            static_assert(false, "non-exhaustive visitor!");
+        }
+    }, expr.data);
+
+    lookups++;
+    auto [it, inserted] = table.try_emplace(key);
+    if (inserted) {
+        it->second = make_shared_in<Expr>(memory, std::move(expr));
+    } else {
+        hits++;
+    }
+    return it->second;
+}
+
+void ExprInterner::clear() {
+    table.clear();
+    lookups = 0;
+    hits = 0;
+}
+
+Span expr_span(const Expr &expr) {
+    return std::visit([](const auto &node) {
+        return node.span;
+    }, expr.data);
+}
@@ -0,0 +1,46 @@
+#ifndef DFA_SAMPLE_INTERN_HPP
+#define DFA_SAMPLE_INTERN_HPP
+
+#include <memory_resource>
+#include <unordered_map>
+#include "ast.hpp"
+
+// Hash-consing of expressions: the parser turns every subtree that is structurally equal to one seen before,
+// spans aside, into a reference to the same node. Children are interned before their parents, so two subtrees
+// are equal when their operators are and their children are the same nodes. A shared node keeps the spans of its
+// first occurrence. The nodes point into the source, so a table only serves one source at a time.
+class ExprInterner {
+    struct Key {
+        size_t index;
+        int value;
+        BinaryOp op;
+        std::string_view name;
+        const Expr *lhs;
+        const Expr *rhs;
+
+        bool operator==(const Key &other) const = default;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const;
+    };
+
+    std::unordered_map<Key, std::shared_ptr<Expr>, KeyHash> table;
+
+public:
+    size_t lookups = 0;
+    size_t hits = 0;
+
+    std::shared_ptr<Expr> intern(Expr expr, std::pmr::memory_resource *memory);
+
+    // drops every node, to start over with another source
+    void clear();
+
+    [[nodiscard]] size_t unique_expressions() const {
+        return table.size();
+    }
+};
+
+Span expr_span(const Expr &expr);
+
+#endif //DFA_SAMPLE_INTERN_HPP
@@ -0,0 +1,318 @@
+#include "lanes.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include "bytecode.hpp"
+#include "trace.hpp"
+#include "visitor.hpp"
+
+// Eight 32-bit lanes in GCC's vector extensions: one AVX2 register, or two SSE ones. Arithmetic goes through
+// the unsigned type, which wraps around.
+typedef int32_t LaneVector __attribute__((vector_size(32)));
+typedef uint32_t UnsignedLaneVector __attribute__((vector_size(32)));
+typedef double LaneDoubles __attribute__((vector_size(64)));
+
+static constexpr size_t vector_lanes = 8;
+static constexpr size_t block_vectors = 8;
+static constexpr size_t block_lanes = vector_lanes * block_vectors;
+
+// The value of a variable, or a mask of 0 and -1, for every lane of a block. Without AVX, GCC only aligns the
+// vector types to 16 bytes, but the AVX2 kernel loads and stores them aligned.
+struct alignas(32) LaneBlock {
+    LaneVector v[block_vectors];
+};
+
+// The kernels are built for AVX2 as well as for the baseline, and the loader picks one for the CPU it runs on.
+// GCC (12 at least) treats calls through the dispatcher of a target_clones function as if they could not throw,
+// so the caller gets no landing pad and an exception thrown in a clone ends in std::terminate instead of reaching
+// its catch. The kernels report faults as LaneFault instead, and run_lanes throws them outside of the clones.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__)
+#define LANE_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define LANE_KERNEL
+#endif
+#define LANE_INLINE [[gnu::always_inline]] inline
+
+struct LaneLowering : public StaticAstVisitor<LaneLowering> {
+    const std::unordered_map<std::string_view, uint16_t> &variables;
+    LaneExpr out;
+    size_t depth = 0;
+    size_t max_depth = 0;
+
+    explicit LaneLowering(const std::unordered_map<std::string_view, uint16_t> &variables) : variables(variables) {
+    }
+
+    void push(const LaneOp &op) {
+        out.ops.push_back(op);
+        max_depth = std::max(max_depth, ++depth);
+    }
+
+    void visit_name(const Name &name) {
+        push(LaneOp{.kind = FlatOpKind::Name, .variable = variables.at(name.name), .value = 0});
+    }
+
+    void visit_constant(const Constant &constant) {
+        push(LaneOp{.kind = FlatOpKind::Constant, .variable = 0, .value = constant.value});
+    }
+
+    void visit_binary_expr(const BinaryExpr &binary_expr) {
+        walk_binary_expr(binary_expr);
+        out.ops.push_back(LaneOp{.kind = flat_op_kind(binary_expr.op), .variable = 0, .value = 0});
+        depth--;
+    }
+};
+
+class LaneCompiler {
+    LaneProgram program;
+    std::unordered_map<std::string_view, uint16_t> variables;
+
+    LaneExpr lower(const Expr &expr) {
+        LaneLowering lowering{variables};
+        lowering.visit_expr(expr);
+        program.max_stack = std::max(program.max_stack, lowering.max_depth);
+        return std::move(lowering.out);
+    }
+
+    std::vector<LaneStmt> compile_statements(const StmtList &stmt_list) {
+        std::vector<LaneStmt> statements;
+        statements.reserve(stmt_list.statements.size());
+        for (const Stmt &stmt: stmt_list.statements) {
+            std::visit([&]<typename T0>(T0 &&node) {
+                using T = std::decay_t<T0>;
+                if constexpr (std::is_same_v<T, AssignmentStmt>) {
+                    statements.push_back(LaneStmt{LaneAssignment{
+                        .variable = variables.at(node.lhs.name), .value = lower(*node.rhs),
+                    }});
+                } else if constexpr (std::is_same_v<T, IfStmt>) {
+                    statements.push_back(LaneStmt{LaneIf{
+                        .condition = lower(*node.condition), .body = compile_statements(*node.then_block),
+                    }});
+                } else if constexpr (std::is_same_v<T, WhileStmt>) {
+                    statements.push_back(LaneStmt{LaneWhile{
+                        .condition = lower(*node.condition), .body = compile_statements(*node.body),
+                    }});
+                } else {
+                    static_assert(false, "non-exhaustive visitor!");
+                }
+            }, stmt.data);
+        }
+        return statements;
+    }
+
+public:
+    LaneProgram compile(const Program &source) {
+        program.variables = program_variables(source);
+        if (program.variables.size() > std::numeric_limits<uint16_t>::max()) {
+            throw std::runtime_error("Too many variables");
+        }
+        for (size_t i = 0; i < program.variables.size(); i++) {
+            variables.emplace(program.variables[i], static_cast<uint16_t>(i));
+        }
+        program.statements = compile_statements(source.statements);
+        return std::move(program);
+    }
+};
+
+LaneProgram compile_lanes(const Program &program) {
+    TraceScope trace{"compile_lanes"};
+    return LaneCompiler{}.compile(program);
+}
+
+enum class LaneFault : uint8_t {
+    None,
+    DivisionByZero,
+    IterationLimit,
+};
+
+struct LaneContext {
+    LaneBlock *variables;
+    LaneBlock *stack;
+    uint64_t max_iterations;
+};
+
+LANE_INLINE bool any_lane(const LaneBlock &mask) {
+    LaneVector any = mask.v[0];
+    for (size_t i = 1; i < block_vectors; i++) {
+        any |= mask.v[i];
+    }
+    for (size_t j = 0; j < vector_lanes; j++) {
+        if (any[j] != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Divides the lanes in `mask`, or returns false if one of them divides by zero. There is no vector integer
+// division, so it goes through doubles: they hold every int32_t exactly, and the quotient of two of them rounded
+// to a double is off by less than its distance to the next integer, so truncating it gives the integer quotient.
+// The lanes outside `mask` may hold anything and divide by 1, like the one quotient that does not fit,
+// INT32_MIN / -1, which apply_binary_op leaves at INT32_MIN.
+LANE_INLINE bool divide_lanes(LaneBlock &lhs, const LaneBlock &rhs, const LaneBlock &mask) {
+    LaneVector by_zero{};
+    for (size_t i = 0; i < block_vectors; i++) {
+        by_zero |= mask.v[i] & (rhs.v[i] == 0);
+    }
+    for (size_t j = 0; j < vector_lanes; j++) {
+        if (by_zero[j] != 0) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < block_vectors; i++) {
+        const LaneVector keep = ~mask.v[i] | ((lhs.v[i] == std::numeric_limits<int32_t>::min()) & (rhs.v[i] == -1));
+        const LaneVector divisor = (rhs.v[i] & ~keep) | (keep & 1);
+        lhs.v[i] = __builtin_convertvector(__builtin_convertvector(lhs.v[i], LaneDoubles)
+                                           / __builtin_convertvector(divisor, LaneDoubles), LaneVector);
+    }
+    return true;
+}
+
+// Leaves the value of `expr` in the bottom of the stack, or returns false on a division by zero.
+LANE_INLINE bool evaluate_lanes(const LaneExpr &expr, const LaneContext &context, const LaneBlock &mask) {
+    LaneBlock *top = context.stack;
+    for (const LaneOp &op: expr.ops) {
+        switch (op.kind) {
+            case FlatOpKind::Name:
+                *top++ = context.variables[op.variable];
+                continue;
+            case FlatOpKind::Constant:
+                for (size_t i = 0; i < block_vectors; i++) {
+                    top->v[i] = LaneVector{} + op.value;
+                }
+                top++;
+                continue;
+            default:
+                break;
+        }
+        const LaneBlock &rhs = *--top;
+        LaneBlock &lhs = top[-1];
+        switch (op.kind) {
+            case FlatOpKind::Add:
+                for (size_t i = 0; i < block_vectors; i++) {
+                    lhs.v[i] = (LaneVector) ((UnsignedLaneVector) lhs.v[i] + (UnsignedLaneVector) rhs.v[i]);
+                }
+                break;
+            case FlatOpKind::Sub:
+                for (size_t i = 0; i < block_vectors; i++) {
+                    lhs.v[i] = (LaneVector) ((UnsignedLaneVector) lhs.v[i] - (UnsignedLaneVector) rhs.v[i]);
+                }
+                break;
+            case FlatOpKind::Mul:
+                for (size_t i = 0; i < block_vectors; i++) {
+                    lhs.v[i] = (LaneVector) ((UnsignedLaneVector) lhs.v[i] * (UnsignedLaneVector) rhs.v[i]);
+                }
+                break;
+            case FlatOpKind::Div:
+                if (!divide_lanes(lhs, rhs, mask)) {
+                    return false;
+                }
+                break;
+            case FlatOpKind::Lt:
+                for (size_t i = 0; i < block_vectors; i++) {
+                    lhs.v[i] = (lhs.v[i] < rhs.v[i]) & 1;
+                }
+                break;
+            case FlatOpKind::Gt:
+                for (size_t i = 0; i < block_vectors; i++) {
+                    lhs.v[i] = (lhs.v[i] > rhs.v[i]) & 1;
+                }
+                break;
+            default:
+                std::unreachable();
+        }
+    }
+    return true;
+}
+
+// The lanes of `mask` where `condition` holds.
+LANE_INLINE bool condition_mask(const LaneExpr &condition, const LaneContext &context, const LaneBlock &mask,
+                                LaneBlock &taken) {
+    if (!evaluate_lanes(condition, context, mask)) {
+        return false;
+    }
+    for (size_t i = 0; i < block_vectors; i++) {
+        taken.v[i] = mask.v[i] & (context.stack->v[i] != 0);
+    }
+    return true;
+}
+
+LANE_KERNEL static LaneFault run_lane_statements(const std::vector<LaneStmt> &statements,
+                                                 const LaneContext &context, const LaneBlock &mask) {
+    for (const LaneStmt &stmt: statements) {
+        if (const auto *assignment = std::get_if<LaneAssignment>(&stmt.data)) {
+            if (!evaluate_lanes(assignment->value, context, mask)) {
+                return LaneFault::DivisionByZero;
+            }
+            LaneBlock &variable = context.variables[assignment->variable];
+            for (size_t i = 0; i < block_vectors; i++) {
+                variable.v[i] = (context.stack->v[i] & mask.v[i]) | (variable.v[i] & ~mask.v[i]);
+            }
+        } else if (const auto *if_stmt = std::get_if<LaneIf>(&stmt.data)) {
+            LaneBlock taken;
+            if (!condition_mask(if_stmt->condition, context, mask, taken)) {
+                return LaneFault::DivisionByZero;
+            }
+            if (any_lane(taken)) {
+                if (const LaneFault fault = run_lane_statements(if_stmt->body, context, taken);
+                    fault != LaneFault::None) {
+                    return fault;
+                }
+            }
+        } else {
+            const auto &while_stmt = std::get<LaneWhile>(stmt.data);
+            // lanes leave the loop for good once their condition fails
+            LaneBlock looping = mask;
+            for (uint64_t iterations = 0;; iterations++) {
+                if (!condition_mask(while_stmt.condition, context, looping, looping)) {
+                    return LaneFault::DivisionByZero;
+                }
+                if (!any_lane(looping)) {
+                    break;
+                }
+                if (iterations == context.max_iterations) {
+                    return LaneFault::IterationLimit;
+                }
+                if (const LaneFault fault = run_lane_statements(while_stmt.body, context, looping);
+                    fault != LaneFault::None) {
+                    return fault;
+                }
+            }
+        }
+    }
+    return LaneFault::None;
+}
+
+void run_lanes(const LaneProgram &program, LaneColumns &columns, const uint64_t max_iterations) {
+    TraceScope trace{"run_lanes"};
+    const size_t variable_count = program.variables.size();
+    if (columns.values.size() != variable_count * columns.sets) {
+        throw std::runtime_error("Columns do not match the program");
+    }
+    std::vector<LaneBlock> variables(variable_count);
+    std::vector<LaneBlock> stack(std::max<size_t>(program.max_stack, 1));
+    const LaneContext context{.variables = variables.data(), .stack = stack.data(), .max_iterations = max_iterations};
+    for (size_t start = 0; start < columns.sets; start += block_lanes) {
+        const size_t lanes = std::min(block_lanes, columns.sets - start);
+        for (size_t v = 0; v < variable_count; v++) {
+            variables[v] = LaneBlock{};
+            std::memcpy(&variables[v], columns.column(v) + start, lanes * sizeof(int32_t));
+        }
+        LaneBlock mask{};
+        for (size_t lane = 0; lane < lanes; lane++) {
+            mask.v[lane / vector_lanes][lane % vector_lanes] = -1;
+        }
+        switch (run_lane_statements(program.statements, context, mask)) {
+            case LaneFault::None:
+                break;
+            case LaneFault::DivisionByZero:
+                throw std::runtime_error("Division by zero");
+            case LaneFault::IterationLimit:
+                throw std::runtime_error("Iteration limit exceeded");
+        }
+        for (size_t v = 0; v < variable_count; v++) {
+            std::memcpy(columns.column(v) + start, &variables[v], lanes * sizeof(int32_t));
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef DFA_SAMPLE_LANES_HPP
+#define DFA_SAMPLE_LANES_HPP
+
+#include <cstdint>
+#include <string>
+#include <variant>
+#include <vector>
+#include "ast.hpp"
+#include "flat_expr.hpp"
+
+// The lane engine runs one program over many input sets at once, a block of them at a time, with every
+// operation applied to all the lanes of a block. Lanes that disagree on a condition are masked off: an if runs
+// its body for the lanes that take it, and a loop runs until none of its lanes is left in it.
+
+struct LaneOp {
+    FlatOpKind kind;
+    // the variable of Name ops
+    uint16_t variable;
+    // the value of Constant ops
+    int32_t value;
+};
+
+// An expression in post-order, see FlatExpr.
+struct LaneExpr {
+    std::vector<LaneOp> ops;
+};
+
+struct LaneStmt;
+
+struct LaneAssignment {
+    uint16_t variable;
+    LaneExpr value;
+};
+
+struct LaneIf {
+    LaneExpr condition;
+    std::vector<LaneStmt> body;
+};
+
+struct LaneWhile {
+    LaneExpr condition;
+    std::vector<LaneStmt> body;
+};
+
+struct LaneStmt {
+    std::variant<LaneAssignment, LaneIf, LaneWhile> data;
+};
+
+struct LaneProgram {
+    std::vector<LaneStmt> statements;
+    // in the order of program_variables, like the bytecode
+    std::vector<std::string> variables;
+    // the deepest any expression takes the evaluation stack
+    size_t max_stack = 0;
+};
+
+LaneProgram compile_lanes(const Program &program);
+
+// The values of every variable for a number of input sets, one column per variable.
+struct LaneColumns {
+    size_t sets = 0;
+    // `sets` values for each variable in turn, in the order of LaneProgram::variables
+    std::vector<int32_t> values;
+
+    int32_t *column(const size_t variable) {
+        return values.data() + variable * sets;
+    }
+};
+
+// Runs `program` once per input set of `columns`, from the values in there to the final ones, with the same
+// semantics as run_bytecode. Throws std::runtime_error on a division by zero in any set, or once a loop has
+// gone round more than `max_iterations` times for a block.
+void run_lanes(const LaneProgram &program, LaneColumns &columns, uint64_t max_iterations = UINT64_MAX);
+
+#endif //DFA_SAMPLE_LANES_HPP
@@ -1,12 +1,33 @@
 #include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <fstream>
+#include <optional>
 #include <sstream>
+#include <unistd.h>
 
-#include "parse.hpp"
-#include "dfg_analysis.hpp"
-#include "dfg.hpp"
+#include "bytecode.hpp"
+#include "constexpr_analysis.hpp"
+#include "dead_stores.hpp"
+#include "dfa_core.hpp"
+#include "graph_export.hpp"
+#include "incremental.hpp"
+#include "lanes.hpp"
+#include "mapped_file.hpp"
+#include "memory.hpp"
+#include "server.hpp"
+#include "batch.hpp"
+#include "pipeline.hpp"
+#include "region_analysis.hpp"
+#include "reporter.hpp"
+#include "snapshot.hpp"
+#include "stats.hpp"
+#include "streaming.hpp"
+#include "trace.hpp"
+#include "use_def.hpp"
+#include "work_stealing.hpp"
 
-const char* SRC = R"(
+constexpr std::string_view SRC = R"(
 a = 1
 b = a
 x = 3
@@ -20,41 +41,569 @@ while (b < 5)
 end
 )";
 
+// analysed at compile time, see constexpr_analysis.hpp
+constexpr auto SRC_REPORT = analyse_source_constexpr(SRC);
+
+static bool read_file(const char* path, std::string& src) {
+    std::ifstream fin(path);
+    if (!fin) {
+        std::cerr << "Failed to open file " << path << std::endl;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << fin.rdbuf();
+    src = buffer.str();
+    return true;
+}
+
+// Every line of the edits file is `<start> <end> <replacement>`, where the replacement may contain the escapes
+// \n, \t and \\ (backslash). The edits are applied in order, each one to the source resulting from the previous ones.
+static bool read_edits(const char* path, std::vector<TextEdit>& edits) {
+    std::string contents;
+    if (!read_file(path, contents)) {
+        return false;
+    }
+    std::istringstream lines(contents);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        std::istringstream fields(line);
+        TextEdit edit{};
+        if (!(fields >> edit.start >> edit.end)) {
+            std::cerr << "Invalid edit: " << line << std::endl;
+            return false;
+        }
+        fields.get();
+        std::string escaped;
+        std::getline(fields, escaped);
+        for (size_t i = 0; i < escaped.size(); i++) {
+            if (escaped[i] != '\\' || i + 1 == escaped.size()) {
+                edit.replacement += escaped[i];
+                continue;
+            }
+            switch (const char c = escaped[++i]) {
+                case 'n':
+                    edit.replacement += '\n';
+                    break;
+                case 't':
+                    edit.replacement += '\t';
+                    break;
+                default:
+                    edit.replacement += c;
+                    break;
+            }
+        }
+        edits.push_back(std::move(edit));
+    }
+    return true;
+}
+
+// Writes out what is left in `out`, and returns the exit code: 1 if any of the output could not be written.
+static int finish_output(ReportBuffer& out) {
+    if (!out.flush()) {
+        std::cerr << "error: failed to write output: " << std::strerror(out.error()) << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+static int report_single_file(const ReportFormat format, const std::string_view path, const std::string_view src,
+                              const std::vector<UnusedAssignment>& unused_assignments) {
+    ReportBuffer out{STDOUT_FILENO};
+    const std::unique_ptr<Reporter> reporter = make_reporter(format, false);
+    reporter->begin_run(out);
+    report_file(*reporter, out, path, src, unused_assignments);
+    reporter->end_run(out);
+    return finish_output(out);
+}
+
+static int run_incremental(const std::string& path, const std::string& src, const char* edits_path,
+                           const ReportFormat format) {
+    std::vector<TextEdit> edits;
+    if (!read_edits(edits_path, edits)) {
+        return 1;
+    }
+    // the names in the results point into the analysis, so it has to outlive them
+    std::optional<IncrementalAnalysis> analysis;
+    std::vector<UnusedAssignment> results;
+    try {
+        analysis.emplace(src);
+        for (size_t i = 0; i < edits.size(); i++) {
+            analysis->apply_edit(edits[i]);
+            std::cerr << "edit " << i << ": reparsed " << analysis->last_reparsed << " statement(s), re-analysed "
+                      << analysis->last_reanalysed << " statement(s)" << std::endl;
+        }
+        results = analysis->unused_assignments();
+    } catch (const std::runtime_error& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    return report_single_file(format, path, analysis->source(), results);
+}
+
+// Removes the unused assignments until there are none left, printing the rewritten source.
+static int run_eliminate(const std::string& src) {
+    DeadStoreElimination result;
+    try {
+        result = eliminate_dead_stores(src);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << result.source;
+    std::cerr << "removed " << result.removed.size() << " assignment(s) in " << result.rounds
+              << " round(s), reparsed " << result.reparsed << " statement(s), re-analysed " << result.reanalysed
+              << " statement(s)" << std::endl;
+    return 0;
+}
+
+// Analyses a file too large to hold the trees of all at once, one top-level statement at a time.
+static int run_streaming(const std::string& path, const ReportFormat format) {
+    MappedFile file;
+    if (!file.map(path, false)) {
+        std::cerr << "Failed to open file " << path << std::endl;
+        return 1;
+    }
+    std::vector<UnusedAssignment> results;
+    try {
+        const StreamIndex index = index_statements(file.view());
+        std::cerr << "indexed " << index.statements.size() << " statement(s), the largest of "
+                  << index.max_statement_size << " byte(s)" << std::endl;
+        results = analyse_indexed_source(file.view(), index);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    return report_single_file(format, path, file.view(), results);
+}
+
+// Analyses a single file on `threads` threads, one region of top-level statements per task.
+static int run_parallel(const std::string& path, const std::string& src, const size_t threads,
+                        const ReportFormat format) {
+    std::vector<UnusedAssignment> results;
+    size_t regions = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    try {
+        results = analyse_source_parallel(src, threads, &regions);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cerr << "analysed " << regions << " region(s) in " << elapsed.count() << " s" << std::endl;
+    return report_single_file(format, path, src, results);
+}
+
+// Prints every read of a variable, with the assignments that may have written the value it reads, and `entry`
+// if it may be the value the variable started with.
+static int run_use_def(const std::string& src) {
+    try {
+        ParserState state{Lexer{src}};
+        const Program program = parse_program(state);
+        Cfg cfg = build_cfg(program);
+        ConstantState constants;
+        fold_constant_branches(cfg, constants);
+        const UseDefChains chains = build_use_def_chains(build_dfg(cfg));
+        const LineIndex& lines = state.lexer.lines;
+        for (uint32_t use = 0; use < chains.use_count(); use++) {
+            const auto [line, column] = lines.locate(chains.use(use).span.start);
+            std::cout << line << ":" << column << " " << chains.use(use).name << " <-";
+            const char* separator = " ";
+            for (const uint32_t definition: chains.definitions_reaching(use)) {
+                const auto [def_line, def_column] = lines.locate(chains.definition(definition).span.start);
+                std::cout << separator << def_line << ":" << def_column;
+                separator = ", ";
+            }
+            if (chains.use_reached_from_entry(use)) {
+                std::cout << separator << "entry";
+            }
+            std::cout << "\n";
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Writes the CFG or the DFG of the program, the latter with the liveness of every node if `liveness` is set.
+static int run_graph(const std::string& src, const std::string& graph, const GraphFormat format,
+                     const bool liveness) {
+    if (graph != "cfg" && graph != "dfg") {
+        std::cerr << "Unknown graph " << graph << ", expected cfg or dfg" << std::endl;
+        return 1;
+    }
+    try {
+        ParserState state{Lexer{src}};
+        const Program program = parse_program(state);
+        Cfg cfg = build_cfg(program);
+        ConstantState constants;
+        fold_constant_branches(cfg, constants);
+        ReportBuffer out{STDOUT_FILENO};
+        if (graph == "cfg") {
+            export_cfg(cfg, format, out);
+            return finish_output(out);
+        }
+        const Dfg dfg = build_dfg(cfg);
+        if (!liveness) {
+            export_dfg(dfg, format, out);
+            return finish_output(out);
+        }
+        DfgNodeOutputs outputs;
+        compute_whole_program_required_outputs(program, outputs);
+        DfgNodeUnusedAssignments unused_assignments;
+        DfgInouts inouts;
+        analyse_dfg_inouts(dfg, outputs, unused_assignments, inouts);
+        export_dfg(dfg, format, out, &inouts);
+        return finish_output(out);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+}
+
+// Answers the queries read from stdin, one per line, from a frozen analysis of the program, on `threads` threads
+// that each take chunks of queries: `live LINE:COLUMN` for the variables live before and after the assignment or
+// condition there, and `unused LINE:COLUMN LINE:COLUMN` for the unused assignments overlapping that range.
+static int run_queries(const std::string& src, const size_t threads) {
+    static constexpr size_t queries_per_chunk = 256;
+    SnapshotCell cell;
+    try {
+        cell.publish(freeze_analysis(src));
+    } catch (const std::runtime_error& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    std::vector<std::string> queries;
+    for (std::string line; std::getline(std::cin, line);) {
+        if (!line.empty()) {
+            queries.push_back(std::move(line));
+        }
+    }
+
+    std::vector<std::string> answers(queries.size());
+    const auto parse_position = [](std::istringstream& in, const AnalysisSnapshot& snapshot) {
+        size_t line = 0;
+        size_t column = 0;
+        char colon = 0;
+        if (!(in >> line >> colon >> column) || colon != ':') {
+            return std::optional<size_t>();
+        }
+        return snapshot.offset_of(line, column);
+    };
+    run_work_stealing((queries.size() + queries_per_chunk - 1) / queries_per_chunk, threads,
+                      [&](size_t, const size_t chunk) {
+        const std::shared_ptr<const AnalysisSnapshot> held = cell.acquire();
+        const AnalysisSnapshot& snapshot = *held;
+        for (size_t q = chunk * queries_per_chunk; q < std::min(queries.size(), (chunk + 1) * queries_per_chunk); q++) {
+            std::istringstream in{queries[q]};
+            std::string kind;
+            in >> kind;
+            std::string& answer = answers[q];
+            answer = queries[q] + ":";
+            if (kind == "live") {
+                const std::optional<size_t> offset = parse_position(in, snapshot);
+                const std::optional<uint32_t> point = offset ? snapshot.point_at(*offset) : std::nullopt;
+                if (!point) {
+                    answer += " no assignment or condition there\n";
+                    continue;
+                }
+                answer += " before {";
+                snapshot.live_before(*point, answer);
+                answer += "} after {";
+                snapshot.live_after(*point, answer);
+                answer += "}\n";
+            } else if (kind == "unused") {
+                const std::optional<size_t> start = parse_position(in, snapshot);
+                const std::optional<size_t> end = parse_position(in, snapshot);
+                if (!start || !end) {
+                    answer += " invalid range\n";
+                    continue;
+                }
+                for (const UnusedAssignment& assignment: snapshot.unused_assignments(*start, *end)) {
+                    answer += " " + std::to_string(assignment.line) + ":" + std::to_string(assignment.column) + " "
+                              + std::string(assignment.name);
+                }
+                answer += "\n";
+            } else {
+                answer += " unknown query\n";
+            }
+        }
+    });
+    ReportBuffer out{STDOUT_FILENO};
+    for (const std::string& answer: answers) {
+        out.append(answer);
+    }
+    return finish_output(out);
+}
+
+// Compiles the program to bytecode and runs it, printing the final value of every variable.
+static int run_program(const std::string& src) {
+    BytecodeProgram bytecode;
+    ExecutionResult result;
+    std::chrono::steady_clock::time_point start;
+    try {
+        ParserState state{Lexer{src}};
+        bytecode = compile_bytecode(parse_program(state));
+        start = std::chrono::steady_clock::now();
+        result = run_bytecode(bytecode);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    for (size_t i = 0; i < bytecode.variables.size(); i++) {
+        std::cout << bytecode.variables[i] << " = " << result.values[i] << "\n";
+    }
+    std::cerr << "executed " << result.instructions << " instruction(s) in " << elapsed.count() << " s"
+              << std::endl;
+    return 0;
+}
+
+// Runs the program over `sets` pseudo-random input sets, once with the lane engine and once set by set with the
+// bytecode interpreter, and checks that they agree.
+static int run_lanes_program(const std::string& src, const size_t sets) {
+    using clock = std::chrono::steady_clock;
+    try {
+        ParserState state{Lexer{src}};
+        const Program program = parse_program(state);
+        const BytecodeProgram bytecode = compile_bytecode(program);
+        const LaneProgram lanes = compile_lanes(program);
+        const size_t variable_count = lanes.variables.size();
+
+        LaneColumns columns{.sets = sets, .values = std::vector<int32_t>(variable_count * sets)};
+        uint32_t seed = 1;
+        for (int32_t& value: columns.values) {
+            seed = seed * 1664525 + 1013904223;
+            value = static_cast<int32_t>(seed >> 24) - 128;
+        }
+        std::vector<std::vector<int32_t>> inputs(sets, std::vector<int32_t>(variable_count));
+        for (size_t set = 0; set < sets; set++) {
+            for (size_t v = 0; v < variable_count; v++) {
+                inputs[set][v] = columns.column(v)[set];
+            }
+        }
+
+        const clock::time_point lanes_start = clock::now();
+        run_lanes(lanes, columns);
+        const std::chrono::duration<double> lanes_elapsed = clock::now() - lanes_start;
+
+        const clock::time_point scalar_start = clock::now();
+        size_t mismatches = 0;
+        for (size_t set = 0; set < sets; set++) {
+            const ExecutionResult result = run_bytecode(bytecode, inputs[set]);
+            for (size_t v = 0; v < variable_count; v++) {
+                if (result.values[v] != columns.column(v)[set]) {
+                    mismatches++;
+                    break;
+                }
+            }
+        }
+        const std::chrono::duration<double> scalar_elapsed = clock::now() - scalar_start;
+
+        std::cerr << "lanes: " << sets << " set(s) in " << lanes_elapsed.count() << " s, scalar: "
+                  << scalar_elapsed.count() << " s (" << scalar_elapsed.count() / lanes_elapsed.count()
+                  << "x)" << std::endl;
+        if (mismatches != 0) {
+            std::cerr << "error: " << mismatches << " set(s) differ from the scalar run" << std::endl;
+            return 1;
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    // options that apply to every mode
+    ReportFormat format = ReportFormat::Text;
+    // per-phase statistics of a single file analysis, on stderr
+    enum { NoStats, TextStats, JsonStats } stats = NoStats;
+    // what the phases of a single file analysis allocate from
+    MemoryResourceKind memory_kind = MemoryResourceKind::NewDelete;
+    // whether a single file analysis shares the nodes of equal expressions
+    bool hash_cons = false;
+    // how --graph writes graphs, and whether it adds the liveness of DFG nodes
+    GraphFormat graph_format = GraphFormat::Dot;
+    bool graph_liveness = false;
+    for (auto it = args.begin(); it != args.end();) {
+        if (*it == "--format" && it + 1 != args.end()) {
+            if (!parse_report_format(it[1], format)) {
+                std::cerr << "Unknown format " << it[1] << ", expected text, jsonl or sarif" << std::endl;
+                return 1;
+            }
+            it = args.erase(it, it + 2);
+        } else if (*it == "--stats" || *it == "--stats=text") {
+            stats = TextStats;
+            it = args.erase(it);
+        } else if (*it == "--stats=json") {
+            stats = JsonStats;
+            it = args.erase(it);
+        } else if (*it == "--memory-resource" && it + 1 != args.end()) {
+            if (!parse_memory_resource_kind(it[1], memory_kind)) {
+                std::cerr << "Unknown memory resource " << it[1] << ", expected new, pool or monotonic" << std::endl;
+                return 1;
+            }
+            it = args.erase(it, it + 2);
+        } else if (*it == "--graph-format" && it + 1 != args.end()) {
+            if (!parse_graph_format(it[1], graph_format)) {
+                std::cerr << "Unknown graph format " << it[1] << ", expected dot or json" << std::endl;
+                return 1;
+            }
+            it = args.erase(it, it + 2);
+        } else if (*it == "--graph-liveness") {
+            graph_liveness = true;
+            it = args.erase(it);
+        } else if (*it == "--hash-cons") {
+            hash_cons = true;
+            it = args.erase(it);
+        } else if (*it == "--trace" && it + 1 != args.end()) {
+            // written out at exit
+            if (!start_tracing(it[1].c_str())) {
+                std::cerr << "Failed to start tracing to " << it[1]
+                          << (DFA_TRACING ? "" : ": tracing is compiled out") << std::endl;
+                return 1;
+            }
+            it = args.erase(it, it + 2);
+        } else {
+            ++it;
+        }
+    }
+
+    if (args.size() > 1 && args[0] == "--serve") {
+        size_t cache_entries = 4096;
+        if (args.size() > 3 && args[2] == "--cache-entries") {
+            cache_entries = std::stoul(args[3]);
+        }
+        return run_server(args[1].c_str(), cache_entries);
+    }
+    if (args.size() > 1 && args[0] == "--client") {
+        return run_client(args[1].c_str(), args.size() > 2 ? args[2].c_str() : nullptr, format);
+    }
+    if (!args.empty() && args[0] == "--batch") {
+        size_t threads = 0;
+        size_t memo_entries = 0;
+        size_t first_input = 1;
+        if (args.size() > first_input + 1 && args[first_input] == "--jobs") {
+            threads = std::stoul(args[first_input + 1]);
+            first_input += 2;
+        }
+        if (args.size() > first_input + 1 && args[first_input] == "--memo") {
+            memo_entries = std::stoul(args[first_input + 1]);
+            first_input += 2;
+        }
+        return run_batch(std::vector(args.begin() + first_input, args.end()), threads, format, memo_entries);
+    }
+    if (!args.empty() && args[0] == "--pipeline") {
+        PipelineOptions options;
+        const std::pair<std::string_view, size_t PipelineOptions::*> flags[] = {
+            {"--build-jobs", &PipelineOptions::build_threads},
+            {"--analyse-jobs", &PipelineOptions::analyse_threads},
+            {"--read-depth", &PipelineOptions::read_queue_depth},
+            {"--build-depth", &PipelineOptions::build_queue_depth},
+            {"--write-depth", &PipelineOptions::write_queue_depth},
+        };
+        size_t first_input = 1;
+        for (bool matched = true; matched && first_input + 1 < args.size();) {
+            matched = false;
+            for (const auto &[flag, field]: flags) {
+                if (args[first_input] == flag) {
+                    options.*field = std::stoul(args[first_input + 1]);
+                    first_input += 2;
+                    matched = true;
+                    break;
+                }
+            }
+        }
+        options.format = format;
+        return run_pipeline(std::vector(args.begin() + first_input, args.end()), options);
+    }
+
+    if (args.size() > 1 && args[0] == "--stream") {
+        return run_streaming(args[1], format);
+    }
+
     std::string src;
-    if (argc > 1) {
-        std::ifstream fin(argv[1]);
-        if (!fin) {
-            std::cerr << "Failed to open file " << argv[1] << std::endl;
+    if (args.size() > 1 && args[0] == "--run") {
+        if (!read_file(args[1].c_str(), src)) {
+            return 1;
+        }
+        return run_program(src);
+    }
+    if (args.size() > 1 && args[0] == "--eliminate") {
+        if (!read_file(args[1].c_str(), src)) {
+            return 1;
+        }
+        return run_eliminate(src);
+    }
+    if (args.size() > 1 && args[0] == "--use-def") {
+        if (!read_file(args[1].c_str(), src)) {
+            return 1;
+        }
+        return run_use_def(src);
+    }
+    if (args.size() > 1 && args[0] == "--query") {
+        size_t threads = 0;
+        size_t file = 1;
+        if (args.size() > 3 && args[1] == "--jobs") {
+            threads = std::stoul(args[2]);
+            file = 3;
+        }
+        if (!read_file(args[file].c_str(), src)) {
+            return 1;
+        }
+        return run_queries(src, threads);
+    }
+    if (args.size() > 2 && args[0] == "--graph") {
+        if (!read_file(args[2].c_str(), src)) {
+            return 1;
+        }
+        return run_graph(src, args[1], graph_format, graph_liveness);
+    }
+    if (args.size() > 2 && args[0] == "--lanes") {
+        if (!read_file(args[2].c_str(), src)) {
+            return 1;
+        }
+        return run_lanes_program(src, std::stoul(args[1]));
+    }
+    if (args.size() > 2 && args[0] == "--parallel") {
+        if (!read_file(args[2].c_str(), src)) {
+            return 1;
+        }
+        return run_parallel(args[2], src, std::stoul(args[1]), format);
+    }
+    if (args.size() > 2 && args[0] == "--edits") {
+        if (!read_file(args[2].c_str(), src)) {
+            return 1;
+        }
+        return run_incremental(args[2], src, args[1].c_str(), format);
+    }
+    if (args.empty() && stats == NoStats) {
+        return report_single_file(format, "", SRC, std::vector(SRC_REPORT.begin(), SRC_REPORT.end()));
+    }
+    std::string path;
+    if (!args.empty()) {
+        path = args[0];
+        if (!read_file(path.c_str(), src)) {
             return 1;
         }
-        std::stringstream buffer;
-        buffer << fin.rdbuf();
-        src = buffer.str();
     } else {
         src = SRC;
     }
-    ParserState state{Lexer{src}};
-    const Program p = parse_program(state);
-    const Cfg cfg = build_cfg(p);
-//    dbg_cfg(cfg);
-    const Dfg dfg = build_dfg(cfg);
-//    dbg_dfg(dfg);
-    DfgNodeOutputs outputs;
-    compute_whole_program_required_outputs(p, outputs);
-
-    DfgNodeUnusedAssignments unused_assignments;
-    analyse_dfg(dfg, outputs, unused_assignments);
-    std::ranges::sort(unused_assignments.assignments,
-                      [](const auto &a, const auto &b) {
-                          return a->span.start < b->span.start;
-                      });
-    for (const auto &assignment: unused_assignments.assignments) {
-        std::cout << "Unused assignment to " << assignment->name.name << " at " << assignment->span.start << ".."
-                  << assignment->span.end
-                  << std::endl
-                  << src.substr(assignment->span.start, assignment->span.end - assignment->span.start)
-                  << std::endl;
+    if (stats == NoStats) {
+        Analyzer analyzer{memory_kind, hash_cons};
+        std::vector<UnusedAssignment> results;
+        analyzer.analyse(src, results);
+        return report_single_file(format, path, src, results);
     }
-    return 0;
+    const PhaseMemoryResources memory{memory_kind};
+    AnalysisStats analysis_stats;
+    const int status = report_single_file(format, path, src,
+                                          analyse_source_with_stats(src, analysis_stats, memory.phases(), hash_cons));
+    std::cerr << (stats == JsonStats ? format_stats_json(analysis_stats) : format_stats_text(analysis_stats));
+    return status;
 }
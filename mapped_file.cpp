@@ -0,0 +1,30 @@
+#include "mapped_file.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() {
+    if (data != nullptr) {
+        munmap(data, size);
+    }
+}
+
+bool MappedFile::map(const std::string &path, const bool populate) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st{};
+    bool ok = fstat(fd, &st) == 0;
+    if (ok && st.st_size > 0) {
+        void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | (populate ? MAP_POPULATE : 0), fd, 0);
+        ok = mapped != MAP_FAILED;
+        if (ok) {
+            data = mapped;
+            size = st.st_size;
+        }
+    }
+    close(fd);
+    return ok;
+}
@@ -0,0 +1,28 @@
+#ifndef DFA_SAMPLE_MAPPED_FILE_HPP
+#define DFA_SAMPLE_MAPPED_FILE_HPP
+
+#include <string>
+#include <string_view>
+
+// A whole file mapped read-only into memory.
+class MappedFile {
+    void *data = nullptr;
+    size_t size = 0;
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile();
+
+    // Maps the whole file, and faults it in right away if `populate` is set, so that whoever reads it next does
+    // not wait on I/O. Returns false if it cannot be opened or mapped; an empty file maps to an empty view.
+    bool map(const std::string &path, bool populate = true);
+
+    [[nodiscard]] std::string_view view() const {
+        return {static_cast<const char *>(data), size};
+    }
+};
+
+#endif //DFA_SAMPLE_MAPPED_FILE_HPP
@@ -0,0 +1,102 @@
+#include "memory.hpp"
+#include <algorithm>
+#include <atomic>
+#include <malloc.h>
+
+static std::atomic<bool> allocation_counting{false};
+static thread_local AllocationTotals thread_allocations;
+
+static void count_allocation(AllocationTotals &totals, const size_t requested, const size_t live) {
+    totals.allocations++;
+    totals.bytes += requested;
+    totals.live_bytes += static_cast<int64_t>(live);
+    totals.peak_live_bytes = std::max(totals.peak_live_bytes, totals.live_bytes);
+}
+
+void count_heap_allocation(void *p, const size_t size) {
+    if (allocation_counting.load(std::memory_order_relaxed)) {
+        count_allocation(thread_allocations, size, malloc_usable_size(p));
+    }
+}
+
+void count_heap_deallocation(void *p) {
+    if (p != nullptr && allocation_counting.load(std::memory_order_relaxed)) {
+        thread_allocations.live_bytes -= static_cast<int64_t>(malloc_usable_size(p));
+    }
+}
+
+void enable_allocation_counting() {
+    allocation_counting.store(true, std::memory_order_relaxed);
+}
+
+AllocationScope::AllocationScope() : start(thread_allocations) {
+    // the peak of this phase starts from where it is now
+    thread_allocations.peak_live_bytes = thread_allocations.live_bytes;
+}
+
+AllocationTotals AllocationScope::finish() {
+    const AllocationTotals end = thread_allocations;
+    // an enclosing phase still sees the highest peak of everything inside it
+    thread_allocations.peak_live_bytes = std::max(start.peak_live_bytes, end.peak_live_bytes);
+    return AllocationTotals{
+            .allocations = end.allocations - start.allocations,
+            .bytes = end.bytes - start.bytes,
+            .live_bytes = end.live_bytes - start.live_bytes,
+            .peak_live_bytes = end.peak_live_bytes - start.live_bytes,
+    };
+}
+
+void *CountingMemoryResource::do_allocate(const size_t bytes, const size_t alignment) {
+    void *p = upstream->allocate(bytes, alignment);
+    count_allocation(totals, bytes, bytes);
+    return p;
+}
+
+void CountingMemoryResource::do_deallocate(void *p, const size_t bytes, const size_t alignment) {
+    upstream->deallocate(p, bytes, alignment);
+    totals.live_bytes -= static_cast<int64_t>(bytes);
+}
+
+bool parse_memory_resource_kind(const std::string_view name, MemoryResourceKind &kind) {
+    if (name == "new") {
+        kind = MemoryResourceKind::NewDelete;
+    } else if (name == "pool") {
+        kind = MemoryResourceKind::Pool;
+    } else if (name == "monotonic") {
+        kind = MemoryResourceKind::Monotonic;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+PhaseMemoryResources::PhaseMemoryResources(const MemoryResourceKind kind) : kind(kind) {
+    for (auto &resource: owned) {
+        switch (kind) {
+            case MemoryResourceKind::NewDelete:
+                break;
+            case MemoryResourceKind::Pool:
+                resource = std::make_unique<std::pmr::unsynchronized_pool_resource>();
+                break;
+            case MemoryResourceKind::Monotonic:
+                resource = std::make_unique<std::pmr::monotonic_buffer_resource>();
+                break;
+        }
+    }
+}
+
+PhaseMemory PhaseMemoryResources::phases() const {
+    const auto get = [&](const size_t i) {
+        return owned[i] != nullptr ? owned[i].get() : std::pmr::new_delete_resource();
+    };
+    return PhaseMemory{.parse = get(0), .cfg = get(1), .dfg = get(2), .analysis = get(3)};
+}
+
+void PhaseMemoryResources::release() {
+    if (kind != MemoryResourceKind::Monotonic) {
+        return;
+    }
+    for (const auto &resource: owned) {
+        static_cast<std::pmr::monotonic_buffer_resource *>(resource.get())->release();
+    }
+}
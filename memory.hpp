@@ -0,0 +1,103 @@
+#ifndef DFA_SAMPLE_MEMORY_HPP
+#define DFA_SAMPLE_MEMORY_HPP
+
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+
+struct AllocationTotals {
+    size_t allocations = 0;
+    size_t bytes = 0;
+    // bytes allocated and not freed yet; frees of memory from before counting started can take it below zero
+    int64_t live_bytes = 0;
+    int64_t peak_live_bytes = 0;
+};
+
+// Makes the heap hooks below count on every thread from now on. Before the first call they cost a relaxed load.
+void enable_allocation_counting();
+
+// Called by the replacement operator new and delete in allocation_hooks.cpp, which only the executables link in;
+// a program embedding dfa_core gets no counts unless it installs the same hooks. Live bytes are tracked by
+// malloc's usable size, which is known again when the memory is freed.
+void count_heap_allocation(void *p, size_t size);
+void count_heap_deallocation(void *p);
+
+// Attributes the operator new and delete calls of this thread to a phase, from construction until finish.
+// Scopes nest: an outer phase includes its inner ones.
+class AllocationScope {
+    AllocationTotals start;
+
+public:
+    AllocationScope();
+    AllocationScope(const AllocationScope &) = delete;
+    AllocationScope &operator=(const AllocationScope &) = delete;
+
+    // what the phase allocated, with its peak relative to the live bytes it started with
+    AllocationTotals finish();
+};
+
+// A memory resource counting what goes through it, passing everything on to `upstream`.
+class CountingMemoryResource final : public std::pmr::memory_resource {
+    std::pmr::memory_resource *upstream;
+
+public:
+    AllocationTotals totals;
+
+    explicit CountingMemoryResource(std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+        : upstream(upstream) {
+    }
+
+private:
+    void *do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// Where each phase allocates its nodes and scratch containers. Whatever a phase builds is only valid for as long
+// as its resource is.
+struct PhaseMemory {
+    std::pmr::memory_resource *parse = std::pmr::get_default_resource();
+    std::pmr::memory_resource *cfg = std::pmr::get_default_resource();
+    std::pmr::memory_resource *dfg = std::pmr::get_default_resource();
+    std::pmr::memory_resource *analysis = std::pmr::get_default_resource();
+};
+
+// The memory resources that can be picked by name, each phase getting its own.
+enum class MemoryResourceKind {
+    // operator new and delete
+    NewDelete,
+    // std::pmr::unsynchronized_pool_resource
+    Pool,
+    // std::pmr::monotonic_buffer_resource, freeing nothing until the analysis is done
+    Monotonic,
+};
+
+bool parse_memory_resource_kind(std::string_view name, MemoryResourceKind &kind);
+
+// Owns one resource per phase. Pools keep what is freed into them for the analyses after it; monotonic resources
+// only get their memory back through release.
+class PhaseMemoryResources {
+    MemoryResourceKind kind;
+    std::unique_ptr<std::pmr::memory_resource> owned[4];
+
+public:
+    explicit PhaseMemoryResources(MemoryResourceKind kind);
+
+    [[nodiscard]] PhaseMemory phases() const;
+
+    // Frees the monotonic resources once nothing allocated from them is in use anymore.
+    void release();
+};
+
+// Allocates a T and its control block from `memory`.
+template<typename T, typename... Args>
+std::shared_ptr<T> make_shared_in(std::pmr::memory_resource *memory, Args &&... args) {
+    return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(memory), std::forward<Args>(args)...);
+}
+
+#endif //DFA_SAMPLE_MEMORY_HPP
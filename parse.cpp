@@ -3,6 +3,45 @@
 //
 
 #include "parse.hpp"
+#include "intern.hpp"
+#include "memory.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <bit>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+LineIndex LineIndex::build(const std::string_view src) {
+    LineIndex index;
+    index.line_starts.push_back(0);
+    const char *data = src.data();
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= src.size(); i += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        for (auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline))); mask != 0;
+             mask &= mask - 1) {
+            index.line_starts.push_back(static_cast<uint32_t>(i + std::countr_zero(mask) + 1));
+        }
+    }
+#endif
+    for (; i < src.size(); i++) {
+        if (data[i] == '\n') {
+            index.line_starts.push_back(static_cast<uint32_t>(i + 1));
+        }
+    }
+    return index;
+}
+
+LineIndex::LineColumn LineIndex::locate(const size_t offset) const {
+    const auto line = std::ranges::upper_bound(line_starts, offset) - line_starts.begin();
+    return LineColumn{
+            .line = static_cast<size_t>(line),
+            .column = offset - line_starts[line - 1] + 1,
+    };
+}
 
 std::shared_ptr<Expr> parse_expr(ParserState &state);
 
@@ -32,16 +71,16 @@ Expr parse_expr_atom(ParserState &state) {
         return Expr{
                 .data = ParenExpr{
                         .expr = expr,
-                        .span = Span{start, state.lexer.pos}
+                        .span = state.lexer.span_from(start)
                 }
         };
     }
-    if (isdigit(c)) {
+    if (is_digit(c)) {
         return Expr{
             state.lexer.read_number()
         };
     }
-    if (isalpha(c)) {
+    if (is_alpha(c)) {
         return Expr{
             state.lexer.read_name()
         };
@@ -49,8 +88,15 @@ Expr parse_expr_atom(ParserState &state) {
     throw std::runtime_error("Unexpected character");
 }
 
+static std::shared_ptr<Expr> make_expr(ParserState &state, Expr expr) {
+    if (state.interner != nullptr) {
+        return state.interner->intern(std::move(expr), state.memory);
+    }
+    return make_shared_in<Expr>(state.memory, std::move(expr));
+}
+
 std::shared_ptr<Expr> parse_precedence_1(ParserState &state) {
-    std::shared_ptr<Expr> lhs = std::make_shared<Expr>(parse_expr_atom(state));
+    std::shared_ptr<Expr> lhs = make_expr(state, parse_expr_atom(state));
     state.lexer.skip_whitespace();
 
     if (state.lexer.eof()) {
@@ -61,13 +107,13 @@ std::shared_ptr<Expr> parse_precedence_1(ParserState &state) {
     while (c == '*' || c == '/') {
         const auto start = state.lexer.pos;
         state.lexer.next();
-        std::shared_ptr<Expr> rhs = std::make_shared<Expr>(parse_expr_atom(state));
-        lhs = std::make_shared<Expr>(Expr{
+        std::shared_ptr<Expr> rhs = make_expr(state, parse_expr_atom(state));
+        lhs = make_expr(state, Expr{
                 .data = BinaryExpr{
                         .lhs = lhs,
                         .rhs = rhs,
                         .op = c == '*' ? Mul : Div,
-                        .span = Span{start, state.lexer.pos}
+                        .span = state.lexer.span_from(start)
                 }
         });
         state.lexer.skip_whitespace();
@@ -92,12 +138,12 @@ std::shared_ptr<Expr> parse_precedence_2(ParserState &state) {
         auto start = state.lexer.pos;
         state.lexer.next();
         std::shared_ptr<Expr> rhs = parse_precedence_1(state);
-        lhs = std::make_shared<Expr>(Expr{
+        lhs = make_expr(state, Expr{
                 .data = BinaryExpr{
                         .lhs = std::move(lhs),
                         .rhs = std::move(rhs),
                         .op = c == '+' ? Add : Sub,
-                        .span = Span{start, state.lexer.pos}
+                        .span = state.lexer.span_from(start)
                 }
         });
         state.lexer.skip_whitespace();
@@ -122,12 +168,12 @@ std::shared_ptr<Expr> parse_precedence_3(ParserState &state) {
         auto start = state.lexer.pos;
         state.lexer.next();
         std::shared_ptr<Expr> rhs = parse_precedence_2(state);
-        lhs = std::make_shared<Expr>(Expr{
+        lhs = make_expr(state, Expr{
                 .data = BinaryExpr{
                         .lhs = std::move(lhs),
                         .rhs = std::move(rhs),
                         .op = c == '<' ? Lt : Gt,
-                        .span = Span{start, state.lexer.pos}
+                        .span = state.lexer.span_from(start)
                 }
         });
         state.lexer.skip_whitespace();
@@ -156,7 +202,7 @@ Stmt parse_stmt(ParserState &state, const Name& name) {
         return Stmt{
                 IfStmt{
                         parse_expr(state),
-                        std::make_shared<StmtList>(parse_stmt_list(state, false))
+                        make_shared_in<StmtList>(state.memory, parse_stmt_list(state, false))
                 }
         };
     }
@@ -164,7 +210,7 @@ Stmt parse_stmt(ParserState &state, const Name& name) {
         return Stmt{
             WhileStmt{
                 parse_expr(state),
-                std::make_shared<StmtList>(parse_stmt_list(state, false))
+                make_shared_in<StmtList>(state.memory, parse_stmt_list(state, false))
             }
         };
     }
@@ -180,7 +226,7 @@ Stmt parse_stmt(ParserState &state, const Name& name) {
         AssignmentStmt{
             name,
             parse_expr(state),
-            Span{name.span.start, state.lexer.pre_ws_pos}
+            Span{name.span.start, static_cast<uint32_t>(state.lexer.pre_ws_pos)}
         }
     };
 }
@@ -205,7 +251,24 @@ StmtList parse_stmt_list(ParserState &state, const bool error_on_end) {
     return stmt_list;
 }
 
+static void check_input_size(const ParserState &state) {
+    if (state.lexer.input.size() > Span::max_offset) {
+        throw std::runtime_error("Input too large, a single buffer is limited to 4 GiB");
+    }
+}
+
+Stmt parse_statement(ParserState &state) {
+    check_input_size(state);
+    const Name name = state.lexer.read_name();
+    if (name == "end") {
+        throw std::runtime_error("Unexpected end");
+    }
+    return parse_stmt(state, name);
+}
+
 Program parse_program(ParserState &state) {
+    TraceScope trace{"parse_program"};
+    check_input_size(state);
     Program program;
     program.statements = parse_stmt_list(state, true);
     return program;
@@ -5,68 +5,167 @@
 #ifndef DFA_SAMPLE_PARSE_HPP
 #define DFA_SAMPLE_PARSE_HPP
 
+#include <bit>
+#include <limits>
+#include <memory_resource>
+#include <stdexcept>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "ast.hpp"
 
+// Start offsets of the lines of a source, to turn offsets into line and column numbers.
+struct LineIndex {
+    std::vector<uint32_t> line_starts;
+
+    struct LineColumn {
+        // both 1-based, columns in bytes
+        size_t line;
+        size_t column;
+    };
+
+    // for text that is not lexed, see Lexer::lines; finds the line breaks 16 bytes at a time where SSE2 is available
+    static LineIndex build(std::string_view src);
+
+    [[nodiscard]] LineColumn locate(size_t offset) const;
+};
+
+// The character classes of the C locale, usable in constant expressions.
+constexpr bool is_space(const char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+constexpr bool is_digit(const char c) {
+    return c >= '0' && c <= '9';
+}
+
+constexpr bool is_alpha(const char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+constexpr bool is_alnum(const char c) {
+    return is_alpha(c) || is_digit(c);
+}
+
+// Usable in constant expressions, see constexpr_analysis.hpp.
 struct Lexer {
     std::string_view input;
     size_t pos = 0;
     size_t pre_ws_pos = 0;
+    // the starts of the lines lexed so far; newlines only ever appear in whitespace, so skip_whitespace finds them
+    // all on the way, with a vectorized scan of the run outside of constant evaluation
+    LineIndex lines{.line_starts = {0}};
 
-    [[nodiscard]] char peek() const {
+    [[nodiscard]] constexpr char peek() const {
         return input[pos];
     }
 
-    char next() {
+    constexpr char next() {
         return input[pos++];
     }
 
-    [[nodiscard]] bool eof() const {
+    [[nodiscard]] constexpr bool eof() const {
         return pos >= input.size();
     }
 
-    void skip_whitespace() {
-        if (eof() || !isspace(peek())) {
+    [[nodiscard]] constexpr Span span_from(const size_t start) const {
+        return Span{static_cast<uint32_t>(start), static_cast<uint32_t>(pos)};
+    }
+
+    constexpr void skip_whitespace() {
+        if (eof() || !is_space(peek())) {
             return;
         }
         pre_ws_pos = pos;
-        while (!eof() && isspace(peek())) {
-            next();
+        // most runs are a space, or a line break and an indent, which is over before a vector would be loaded;
+        // longer ones go on 16 bytes at a time
+        for (size_t scanned = 1; !eof() && is_space(peek()); scanned++) {
+            if (next() == '\n') {
+                lines.line_starts.push_back(static_cast<uint32_t>(pos));
+            }
+            if (scanned == 8) {
+                if !consteval {
+                    skip_whitespace_16();
+                }
+            }
         }
     }
 
-    Name read_name() {
+    // Skips whitespace 16 bytes at a time where SSE2 is available, taking the line starts from the newline mask of
+    // each chunk, and leaves the end of a run that goes on to the end of the input to the scalar loop.
+    void skip_whitespace_16() {
+#if defined(__SSE2__)
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i tab = _mm_set1_epi8('\t');
+        // '\t' to '\r', as unsigned offsets from '\t'
+        const __m128i control_range = _mm_set1_epi8('\r' - '\t');
+        while (pos + 16 <= input.size()) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input.data() + pos));
+            const __m128i control = _mm_sub_epi8(chunk, tab);
+            const __m128i is_ws = _mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+                                               _mm_cmpeq_epi8(_mm_min_epu8(control, control_range), control));
+            const auto ws = static_cast<unsigned>(_mm_movemask_epi8(is_ws));
+            const unsigned run = std::countr_one(ws);
+            auto newlines = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)))
+                            & ((1u << run) - 1);
+            for (; newlines != 0; newlines &= newlines - 1) {
+                lines.line_starts.push_back(static_cast<uint32_t>(pos + std::countr_zero(newlines) + 1));
+            }
+            pos += run;
+            if (run < 16) {
+                return;
+            }
+        }
+#endif
+    }
+
+    constexpr Name read_name() {
         skip_whitespace();
 
         const auto start = pos;
-        while (!eof() && isalnum(peek())) {
+        while (!eof() && is_alnum(peek())) {
             next();
         }
 
         return Name{
                 input.substr(start, pos - start),
-                Span{start, pos}
+                span_from(start)
         };
     }
 
-    Constant read_number() {
+    constexpr Constant read_number() {
         skip_whitespace();
 
         const auto start = pos;
-        while (!eof() && isdigit(peek())) {
-            next();
+        // what std::stoi makes of the digits, without a copy of them, failing like the rest of the parser
+        int64_t val = 0;
+        while (!eof() && is_digit(peek())) {
+            val = val * 10 + (next() - '0');
+            if (val > std::numeric_limits<int>::max()) {
+                throw std::runtime_error("Number out of range");
+            }
         }
-        const int val = std::stoi(std::string(input.substr(start, pos - start)));
         return Constant{
-                val,
-                Span{start, pos}
+                static_cast<int>(val),
+                span_from(start)
         };
     }
 };
 
+class ExprInterner;
+
 struct ParserState {
     Lexer lexer;
+    // where the AST nodes are allocated
+    std::pmr::memory_resource *memory = std::pmr::get_default_resource();
+    // if set, equal expressions share one node, see ExprInterner
+    ExprInterner *interner = nullptr;
 };
 
 Program parse_program(ParserState &state);
 
+// Parses a single statement starting at the current position.
+Stmt parse_statement(ParserState &state);
+
 #endif //DFA_SAMPLE_PARSE_HPP
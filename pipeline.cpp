@@ -0,0 +1,234 @@
+#include "pipeline.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <thread>
+#include <unistd.h>
+#include "analysis.hpp"
+#include "batch.hpp"
+#include "bounded_queue.hpp"
+#include "parse.hpp"
+#include "cfg.hpp"
+#include "constant_propagation.hpp"
+#include "dfg.hpp"
+#include "dfg_analysis.hpp"
+#include "mapped_file.hpp"
+#include "trace.hpp"
+#include "work_stealing.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+struct PipelineFile {
+    size_t index;
+    std::string path;
+    MappedFile source;
+    std::string error;
+    LineIndex lines;
+    Program program;
+    Cfg cfg;
+    Dfg dfg;
+    DfgNodeOutputs outputs;
+    std::string report;
+};
+
+using PipelineFilePtr = std::unique_ptr<PipelineFile>;
+
+struct StageStats {
+    const char *name;
+    size_t threads;
+    std::atomic<Clock::rep> busy{0};
+    std::atomic<Clock::rep> waiting_for_input{0};
+    std::atomic<Clock::rep> blocked_on_output{0};
+
+    StageStats(const char *name, const size_t threads) : name(name), threads(threads) {
+    }
+};
+
+// Runs one worker of a stage between two queues, accounting for where its time goes.
+template<typename Work>
+static void run_stage_worker(StageStats &stats, BoundedQueue<PipelineFilePtr> &input,
+                             BoundedQueue<PipelineFilePtr> &output, Work work) {
+    Clock::time_point t0 = Clock::now();
+    while (std::optional<PipelineFilePtr> file = input.pop()) {
+        const Clock::time_point t1 = Clock::now();
+        {
+            TraceScope trace{stats.name};
+            trace.arg(0, "index", (*file)->index);
+            work(**file);
+        }
+        const Clock::time_point t2 = Clock::now();
+        output.push(std::move(*file));
+        const Clock::time_point t3 = Clock::now();
+        stats.waiting_for_input += (t1 - t0).count();
+        stats.busy += (t2 - t1).count();
+        stats.blocked_on_output += (t3 - t2).count();
+        t0 = t3;
+    }
+    stats.waiting_for_input += (Clock::now() - t0).count();
+    output.producer_done();
+}
+
+static void build_file(PipelineFile &file) {
+    if (!file.error.empty()) {
+        return;
+    }
+    try {
+        ParserState state{Lexer{file.source.view()}};
+        file.program = parse_program(state);
+        file.lines = std::move(state.lexer.lines);
+        file.cfg = build_cfg(file.program);
+        ConstantState constants;
+        fold_constant_branches(file.cfg, constants);
+        file.dfg = build_dfg(file.cfg);
+        compute_whole_program_required_outputs(file.program, file.outputs);
+    } catch (const std::exception &e) {
+        file.error = e.what();
+    }
+}
+
+static void analyse_file(PipelineFile &file, const ReportFormat format) {
+    std::vector<UnusedAssignment> unused;
+    if (file.error.empty()) {
+        try {
+            DfgNodeUnusedAssignments unused_assignments;
+            analyse_dfg(file.dfg, file.outputs, unused_assignments);
+            unused = sorted_unused_assignments(unused_assignments, file.lines);
+        } catch (const std::exception &e) {
+            file.error = e.what();
+        }
+    }
+    ReportBuffer report;
+    const std::unique_ptr<Reporter> reporter = make_reporter(format, true);
+    if (file.error.empty()) {
+        report_file(*reporter, report, file.path, file.source.view(), unused);
+    } else {
+        reporter->begin_file(report, file.path, "");
+        reporter->error(report, file.error);
+        reporter->end_file(report);
+    }
+    file.report = report.take();
+    // only the report travels further
+    file.dfg = Dfg();
+    file.cfg = Cfg();
+    file.program = Program();
+    file.lines = LineIndex();
+}
+
+static void print_stage(const StageStats &stats, const double elapsed) {
+    const double capacity = elapsed * static_cast<double>(stats.threads);
+    const auto percent = [&](const Clock::rep duration) {
+        return 100.0 * std::chrono::duration<double>(Clock::duration(duration)).count() / capacity;
+    };
+    std::cerr << "  " << std::left << std::setw(8) << stats.name << std::right
+              << std::setw(8) << stats.threads
+              << std::setw(9) << percent(stats.busy) << "%"
+              << std::setw(19) << percent(stats.waiting_for_input) << "%"
+              << std::setw(19) << percent(stats.blocked_on_output) << "%" << std::endl;
+}
+
+static void print_queue(const char *name, const size_t depth, const BoundedQueue<PipelineFilePtr> &queue) {
+    const double pushes = queue.pushes == 0 ? 1.0 : static_cast<double>(queue.pushes);
+    std::cerr << "  queue " << std::left << std::setw(16) << name << std::right
+              << " depth " << depth
+              << ", average fill " << static_cast<double>(queue.size_sum) / pushes
+              << ", " << 100.0 * static_cast<double>(queue.full_pushes) / pushes << "% of pushes blocked"
+              << std::endl;
+}
+
+int run_pipeline(const std::vector<std::string> &inputs, const PipelineOptions &options) {
+    std::vector<std::string> paths;
+    if (!expand_batch_inputs(inputs, paths)) {
+        return 1;
+    }
+    const size_t half_threads = std::max<size_t>(1, default_thread_count() / 2);
+    const size_t build_threads = options.build_threads == 0 ? half_threads : options.build_threads;
+    const size_t analyse_threads = options.analyse_threads == 0 ? half_threads : options.analyse_threads;
+
+    BoundedQueue<PipelineFilePtr> read_queue{options.read_queue_depth, 1};
+    BoundedQueue<PipelineFilePtr> build_queue{options.build_queue_depth, build_threads};
+    BoundedQueue<PipelineFilePtr> write_queue{options.write_queue_depth, analyse_threads};
+    StageStats read_stats{"read", 1};
+    StageStats build_stats{"build", build_threads};
+    StageStats analyse_stats{"analyse", analyse_threads};
+    StageStats write_stats{"write", 1};
+
+    const auto start = Clock::now();
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+        for (size_t i = 0; i < paths.size(); i++) {
+            const Clock::time_point t0 = Clock::now();
+            auto file = std::make_unique<PipelineFile>();
+            file->index = i;
+            file->path = paths[i];
+            if (!file->source.map(file->path)) {
+                file->error = "Failed to open file " + file->path;
+            }
+            const Clock::time_point t1 = Clock::now();
+            read_queue.push(std::move(file));
+            read_stats.busy += (t1 - t0).count();
+            read_stats.blocked_on_output += (Clock::now() - t1).count();
+        }
+        read_queue.producer_done();
+    });
+    for (size_t i = 0; i < build_threads; i++) {
+        threads.emplace_back([&] {
+            run_stage_worker(build_stats, read_queue, build_queue, build_file);
+        });
+    }
+    for (size_t i = 0; i < analyse_threads; i++) {
+        threads.emplace_back([&] {
+            run_stage_worker(analyse_stats, build_queue, write_queue, [&](PipelineFile &file) {
+                analyse_file(file, options.format);
+            });
+        });
+    }
+
+    // files finish out of order, the writer holds on to them until all the ones before are written
+    std::map<size_t, PipelineFilePtr> pending;
+    size_t next_output = 0;
+    size_t failed = 0;
+    ReportBuffer out{STDOUT_FILENO};
+    const std::unique_ptr<Reporter> run_reporter = make_reporter(options.format, true);
+    run_reporter->begin_run(out);
+    Clock::time_point t0 = Clock::now();
+    while (std::optional<PipelineFilePtr> file = write_queue.pop()) {
+        const Clock::time_point t1 = Clock::now();
+        pending.emplace((*file)->index, std::move(*file));
+        for (auto it = pending.begin(); it != pending.end() && it->first == next_output; it = pending.erase(it)) {
+            run_reporter->append_file(out, it->second->report);
+            if (!it->second->error.empty()) {
+                failed++;
+            }
+            next_output++;
+        }
+        const Clock::time_point t2 = Clock::now();
+        write_stats.waiting_for_input += (t1 - t0).count();
+        write_stats.busy += (t2 - t1).count();
+        t0 = t2;
+    }
+    run_reporter->end_run(out);
+    const bool output_written = out.flush();
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cerr << "pipeline: " << paths.size() << " file(s), " << failed << " failed, "
+              << elapsed << " s, " << static_cast<double>(paths.size()) / elapsed << " files/s" << std::endl
+              << std::fixed << std::setprecision(1)
+              << "  stage    threads     busy  waiting for input  blocked on output" << std::endl;
+    print_stage(read_stats, elapsed);
+    print_stage(build_stats, elapsed);
+    print_stage(analyse_stats, elapsed);
+    print_stage(write_stats, elapsed);
+    print_queue("read -> build", options.read_queue_depth, read_queue);
+    print_queue("build -> analyse", options.build_queue_depth, build_queue);
+    print_queue("analyse -> write", options.write_queue_depth, write_queue);
+    std::cerr << std::defaultfloat;
+    if (!output_written) {
+        std::cerr << "error: failed to write output: " << std::strerror(out.error()) << std::endl;
+    }
+    return failed == 0 && output_written ? 0 : 1;
+}
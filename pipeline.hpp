@@ -0,0 +1,25 @@
+#ifndef DFA_SAMPLE_PIPELINE_HPP
+#define DFA_SAMPLE_PIPELINE_HPP
+
+#include <string>
+#include <vector>
+#include "reporter.hpp"
+
+struct PipelineOptions {
+    // threads of the compute stages, half of the hardware threads each if 0
+    size_t build_threads = 0;
+    size_t analyse_threads = 0;
+    // how many files each queue holds before the stage feeding it has to wait
+    size_t read_queue_depth = 64;
+    size_t build_queue_depth = 64;
+    size_t write_queue_depth = 64;
+    ReportFormat format = ReportFormat::Text;
+};
+
+// Analyses the same files as run_batch, with the same output, but as a pipeline of stages connected by bounded
+// queues: a read stage mapping files ahead of the others, build workers (parse, CFG, DFG), analyse workers
+// (liveness, report formatting), and a single writer restoring the input order. Ends with how busy each stage
+// was on stderr, which tells which one limits throughput.
+int run_pipeline(const std::vector<std::string> &inputs, const PipelineOptions &options);
+
+#endif //DFA_SAMPLE_PIPELINE_HPP
@@ -0,0 +1,191 @@
+#include "program_generator.hpp"
+#include <algorithm>
+#include <vector>
+
+// splitmix64, since the standard distributions are not the same everywhere
+struct GeneratorRandom {
+    uint64_t state;
+
+    uint64_t next() {
+        uint64_t z = state += 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    size_t below(const size_t n) {
+        return next() % n;
+    }
+
+    bool chance(const unsigned percent) {
+        return below(100) < percent;
+    }
+};
+
+struct ShapeParameters {
+    size_t variables;
+    size_t min_operands;
+    size_t max_operands;
+    unsigned control_percent;
+    size_t max_depth;
+    unsigned dead_store_percent;
+    // if not 0, expressions repeat the first this many generated
+    size_t expression_pool = 0;
+};
+
+static ShapeParameters shape_parameters(const ProgramShape shape) {
+    switch (shape) {
+        case ProgramShape::StraightLine:
+            return {.variables = 8, .min_operands = 1, .max_operands = 3, .control_percent = 0, .max_depth = 0,
+                    .dead_store_percent = 10};
+        case ProgramShape::DeepNesting:
+            return {.variables = 8, .min_operands = 1, .max_operands = 3, .control_percent = 35, .max_depth = 6,
+                    .dead_store_percent = 10};
+        case ProgramShape::ManyVariables:
+            return {.variables = 52, .min_operands = 1, .max_operands = 4, .control_percent = 10, .max_depth = 2,
+                    .dead_store_percent = 10};
+        case ProgramShape::LongExpressions:
+            return {.variables = 12, .min_operands = 16, .max_operands = 64, .control_percent = 10,
+                    .max_depth = 2, .dead_store_percent = 10};
+        case ProgramShape::DeadStores:
+            return {.variables = 8, .min_operands = 1, .max_operands = 3, .control_percent = 5, .max_depth = 2,
+                    .dead_store_percent = 80};
+        case ProgramShape::RepetitiveExpressions:
+            return {.variables = 12, .min_operands = 16, .max_operands = 64, .control_percent = 10,
+                    .max_depth = 2, .dead_store_percent = 10, .expression_pool = 16};
+    }
+    return {};
+}
+
+class ProgramGenerator {
+    GeneratorRandom random;
+    ShapeParameters parameters;
+    std::string out;
+    size_t remaining;
+    std::vector<std::string> expression_pool;
+
+    char variable() {
+        static constexpr char letters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+        return letters[random.below(parameters.variables)];
+    }
+
+    void operand() {
+        if (random.chance(60)) {
+            out.push_back(variable());
+        } else {
+            out += std::to_string(random.below(100));
+        }
+    }
+
+    void expression() {
+        if (parameters.expression_pool == 0) {
+            fresh_expression();
+        } else if (expression_pool.size() < parameters.expression_pool) {
+            const size_t start = out.size();
+            fresh_expression();
+            expression_pool.emplace_back(out, start);
+        } else {
+            out += expression_pool[random.below(expression_pool.size())];
+        }
+    }
+
+    void fresh_expression() {
+        static constexpr const char *operators[] = {" + ", " - ", " * ", " / ", " < ", " > "};
+        const size_t operands = parameters.min_operands
+                                + random.below(parameters.max_operands - parameters.min_operands + 1);
+        bool parenthesized = false;
+        for (size_t i = 0; i < operands; i++) {
+            if (i > 0) {
+                out += operators[random.below(std::size(operators))];
+            }
+            if (!parenthesized && i + 2 < operands && random.chance(10)) {
+                out.push_back('(');
+                parenthesized = true;
+            }
+            operand();
+            if (parenthesized && random.chance(30)) {
+                out.push_back(')');
+                parenthesized = false;
+            }
+        }
+        if (parenthesized) {
+            out.push_back(')');
+        }
+    }
+
+    void indent(const size_t depth) {
+        out.append(depth * 2, ' ');
+    }
+
+    void assignment(const size_t depth) {
+        const char name = variable();
+        if (random.chance(parameters.dead_store_percent) && remaining > 1) {
+            // stored, then overwritten right away
+            indent(depth);
+            out.push_back(name);
+            out += " = ";
+            operand();
+            out.push_back('\n');
+            remaining--;
+        }
+        indent(depth);
+        out.push_back(name);
+        out += " = ";
+        expression();
+        out.push_back('\n');
+        remaining--;
+    }
+
+    void block(const size_t depth, size_t statements) {
+        while (statements > 0 && remaining > 0) {
+            if (depth < parameters.max_depth && random.chance(parameters.control_percent) && remaining > 2) {
+                const bool loop = random.chance(50);
+                indent(depth);
+                out += loop ? "while " : "if ";
+                expression();
+                out.push_back('\n');
+                remaining--;
+                block(depth + 1, 1 + random.below(std::max<size_t>(1, statements / 2)));
+                indent(depth);
+                out += "end\n";
+            } else {
+                assignment(depth);
+            }
+            statements--;
+        }
+    }
+
+public:
+    ProgramGenerator(const ProgramShape shape, const size_t statements, const uint64_t seed)
+        : random{seed}, parameters(shape_parameters(shape)), remaining(statements) {
+    }
+
+    std::string generate() {
+        while (remaining > 0) {
+            block(0, remaining);
+        }
+        return std::move(out);
+    }
+};
+
+const char *program_shape_name(const ProgramShape shape) {
+    switch (shape) {
+        case ProgramShape::StraightLine:
+            return "straight_line";
+        case ProgramShape::DeepNesting:
+            return "deep_nesting";
+        case ProgramShape::ManyVariables:
+            return "many_variables";
+        case ProgramShape::LongExpressions:
+            return "long_expressions";
+        case ProgramShape::DeadStores:
+            return "dead_stores";
+        case ProgramShape::RepetitiveExpressions:
+            return "repetitive_expressions";
+    }
+    return "unknown";
+}
+
+std::string generate_program(const ProgramShape shape, const size_t statements, const uint64_t seed) {
+    return ProgramGenerator{shape, statements, seed}.generate();
+}
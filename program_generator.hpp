@@ -0,0 +1,37 @@
+#ifndef DFA_SAMPLE_PROGRAM_GENERATOR_HPP
+#define DFA_SAMPLE_PROGRAM_GENERATOR_HPP
+
+#include <cstdint>
+#include <string>
+
+enum class ProgramShape {
+    // long runs of assignments with short right-hand sides
+    StraightLine,
+    // while/if nested up to 6 deep
+    DeepNesting,
+    // all 52 single letter variables
+    ManyVariables,
+    // right-hand sides and conditions with dozens of operators
+    LongExpressions,
+    // most assignments overwritten before anything reads them
+    DeadStores,
+    // long right-hand sides and conditions drawn from a small pool, as in generated or macro-expanded code
+    RepetitiveExpressions,
+};
+
+inline constexpr ProgramShape all_program_shapes[] = {
+    ProgramShape::StraightLine,
+    ProgramShape::DeepNesting,
+    ProgramShape::ManyVariables,
+    ProgramShape::LongExpressions,
+    ProgramShape::DeadStores,
+    ProgramShape::RepetitiveExpressions,
+};
+
+const char *program_shape_name(ProgramShape shape);
+
+// Generates a program of roughly `statements` statements of the given shape. The same seed always gives the
+// same program, independently of the standard library.
+std::string generate_program(ProgramShape shape, size_t statements, uint64_t seed);
+
+#endif //DFA_SAMPLE_PROGRAM_GENERATOR_HPP
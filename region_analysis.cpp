@@ -0,0 +1,111 @@
+#include "region_analysis.hpp"
+#include <algorithm>
+#include <exception>
+#include "cfg.hpp"
+#include "constant_propagation.hpp"
+#include "dfg.hpp"
+#include "parse.hpp"
+#include "trace.hpp"
+#include "work_stealing.hpp"
+
+// Regions per thread, so that threads that finish early can steal from the others.
+static constexpr size_t regions_per_thread = 4;
+
+struct Region {
+    Program program;
+    Cfg cfg;
+    Dfg dfg;
+    RegionSummary summary;
+    std::exception_ptr error;
+};
+
+static void add_selected(const DfgNodeUnusedAssignments &from, const DfgNodeInputs &live_out, const bool live,
+                         DfgNodeUnusedAssignments &unused_assignments) {
+    for (const auto &assignment: from.assignments) {
+        if (live_out.in.contains(assignment->name.name[0]) == live) {
+            unused_assignments.assignments.push_back(assignment);
+        }
+    }
+}
+
+DfgNodeInputs apply_region_summary(const RegionSummary &summary, const DfgNodeInputs &live_out,
+                                   DfgNodeUnusedAssignments &unused_assignments) {
+    add_selected(summary.unused_all, live_out, true, unused_assignments);
+    add_selected(summary.unused_none, live_out, false, unused_assignments);
+    DfgNodeInputs live_in;
+    std::ranges::set_intersection(summary.live_in_all.in, live_out.in, std::inserter(live_in.in, live_in.in.end()));
+    std::ranges::set_difference(summary.live_in_none.in, live_out.in, std::inserter(live_in.in, live_in.in.end()));
+    return live_in;
+}
+
+// Runs `task` for every region on `threads` threads, and rethrows the error of the last region that failed, which
+// is the one the serial analysis, going backwards, would have stopped at.
+template<typename Task>
+static void for_each_region(std::vector<Region> &regions, const size_t threads, const Task &task) {
+    run_work_stealing(regions.size(), threads, [&](size_t, const size_t index) {
+        Region &region = regions[index];
+        if (region.error) {
+            return;
+        }
+        try {
+            task(region, index);
+        } catch (...) {
+            region.error = std::current_exception();
+        }
+    });
+    for (auto it = regions.rbegin(); it != regions.rend(); ++it) {
+        if (it->error) {
+            std::rethrow_exception(it->error);
+        }
+    }
+}
+
+std::vector<UnusedAssignment> analyse_source_parallel(const std::string_view src, size_t threads,
+                                                      size_t *regions_used) {
+    TraceScope trace{"analyse_source_parallel"};
+    if (threads == 0) {
+        threads = default_thread_count();
+    }
+    ParserState state{Lexer{src}};
+    Program program = parse_program(state);
+    DfgNodeOutputs outputs;
+    compute_whole_program_required_outputs(program, outputs);
+
+    // split into regions of about as many top-level statements each
+    std::vector<Stmt> &statements = program.statements.statements;
+    std::vector<Region> regions(std::min(statements.size(), threads * regions_per_thread));
+    for (size_t i = 0; i < regions.size(); i++) {
+        const auto first = statements.begin() + static_cast<ptrdiff_t>(statements.size() * i / regions.size());
+        const auto last = statements.begin() + static_cast<ptrdiff_t>(statements.size() * (i + 1) / regions.size());
+        regions[i].program.statements.statements.assign(std::make_move_iterator(first), std::make_move_iterator(last));
+    }
+    if (regions_used != nullptr) {
+        *regions_used = regions.size();
+    }
+
+    for_each_region(regions, threads, [](Region &region, size_t) {
+        region.cfg = build_cfg(region.program);
+    });
+    ConstantState constants;
+    for (Region &region: regions) {
+        fold_constant_branches(region.cfg, constants);
+    }
+    for_each_region(regions, threads, [&](Region &region, const size_t index) {
+        TraceScope region_trace{"summarise_region"};
+        region_trace.arg(0, "index", index);
+        region.dfg = build_dfg(region.cfg);
+        const bool successor_analysed = index + 1 < regions.size();
+        analyse_dfg_region(region.dfg, outputs, DfgNodeInputs{outputs.out}, successor_analysed,
+                           region.summary.unused_all, region.summary.live_in_all);
+        analyse_dfg_region(region.dfg, outputs, DfgNodeInputs{}, successor_analysed,
+                           region.summary.unused_none, region.summary.live_in_none);
+    });
+
+    DfgNodeUnusedAssignments unused_assignments;
+    DfgNodeInputs live = DfgNodeInputs{outputs.out};
+    for (auto it = regions.rbegin(); it != regions.rend(); ++it) {
+        live = apply_region_summary(it->summary, live, unused_assignments);
+    }
+    // the spans are into `src`, since the regions were parsed as one program
+    return sorted_unused_assignments(unused_assignments, state.lexer.lines);
+}
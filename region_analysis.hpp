@@ -0,0 +1,33 @@
+#ifndef DFA_SAMPLE_REGION_ANALYSIS_HPP
+#define DFA_SAMPLE_REGION_ANALYSIS_HPP
+
+#include <string_view>
+#include <vector>
+#include "analysis.hpp"
+#include "dfg_analysis.hpp"
+
+// What a run of consecutive top-level statements does to the variables required after it, found by analysing it
+// twice: once with every variable of the program required after it, and once with none. The analysis finds the
+// liveness of each variable without looking at the others, so with any other set required after the region, a
+// variable in that set is required before the region and has unused assignments exactly as in the first run,
+// and any other variable as in the second.
+struct RegionSummary {
+    DfgNodeInputs live_in_all;
+    DfgNodeUnusedAssignments unused_all;
+    DfgNodeInputs live_in_none;
+    DfgNodeUnusedAssignments unused_none;
+};
+
+// Applies `summary` to `live_out`, the variables required after its region: returns those required before it,
+// and adds the unused assignments to `unused_assignments`.
+DfgNodeInputs apply_region_summary(const RegionSummary &summary, const DfgNodeInputs &live_out,
+                                   DfgNodeUnusedAssignments &unused_assignments);
+
+// Produces the same results as analyse_source, splitting the top-level statements into regions that are built
+// and summarised on `threads` threads (all hardware threads if 0). The branches are still folded region after
+// region, since constants flow forwards, and one backward sweep over the summaries finds what each region
+// requires after it and picks its results. `regions` is set to the number of regions used, if given.
+std::vector<UnusedAssignment> analyse_source_parallel(std::string_view src, size_t threads = 0,
+                                                      size_t *regions = nullptr);
+
+#endif //DFA_SAMPLE_REGION_ANALYSIS_HPP
@@ -0,0 +1,274 @@
+#include "region_memo.hpp"
+#include <algorithm>
+#include "cfg.hpp"
+#include "constant_propagation.hpp"
+#include "dfg.hpp"
+#include "dfg_analysis.hpp"
+#include "parse.hpp"
+#include "trace.hpp"
+
+// Stands for every variable a summarised statement does not mention; names are alphanumeric, so never this.
+static constexpr char other_variable = '\0';
+
+static uint64_t mix(const uint64_t hash, const uint64_t value) {
+    // splitmix64's finaliser over the combined value
+    uint64_t x = hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static uint64_t hash_name(const std::string_view name, std::string *encoding) {
+    if (encoding != nullptr) {
+        encoding->append(name);
+        encoding->push_back(';');
+    }
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (const char c: name) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static void encode_tag(const char tag, std::string *encoding) {
+    if (encoding != nullptr) {
+        encoding->push_back(tag);
+    }
+}
+
+static uint64_t hash_expr(const Expr &expr, std::string *encoding) {
+    return std::visit([&]<typename T0>(T0 &&node) -> uint64_t {
+        using T = std::decay_t<T0>;
+        if constexpr (std::is_same_v<T, Name>) {
+            encode_tag('n', encoding);
+            return mix('n', hash_name(node.name, encoding));
+        } else if constexpr (std::is_same_v<T, Constant>) {
+            encode_tag('c', encoding);
+            if (encoding != nullptr) {
+                encoding->append(std::to_string(node.value));
+                encoding->push_back(';');
+            }
+            return mix('c', static_cast<uint32_t>(node.value));
+        } else if constexpr (std::is_same_v<T, ParenExpr>) {
+            encode_tag('(', encoding);
+            const uint64_t inner = hash_expr(*node.expr, encoding);
+            encode_tag(')', encoding);
+            return mix('(', inner);
+        } else if constexpr (std::is_same_v<T, BinaryExpr>) {
+            encode_tag('b', encoding);
+            encode_tag(static_cast<char>('0' + node.op), encoding);
+            const uint64_t lhs = hash_expr(*node.lhs, encoding);
+            const uint64_t rhs = hash_expr(*node.rhs, encoding);
+            return mix(mix(mix('b', node.op), lhs), rhs);
+        } else {
+            static_assert(false, "non-exhaustive visitor!");
+        }
+    }, expr.data);
+}
+
+uint64_t structural_hash(const Stmt &stmt, std::string *encoding) {
+    return std::visit([&]<typename T0>(T0 &&node) -> uint64_t {
+        using T = std::decay_t<T0>;
+        if constexpr (std::is_same_v<T, AssignmentStmt>) {
+            encode_tag('a', encoding);
+            const uint64_t lhs = hash_name(node.lhs.name, encoding);
+            return mix(mix('a', lhs), hash_expr(*node.rhs, encoding));
+        } else if constexpr (std::is_same_v<T, IfStmt>) {
+            encode_tag('i', encoding);
+            const uint64_t condition = hash_expr(*node.condition, encoding);
+            return mix(mix('i', condition), structural_hash(*node.then_block, encoding));
+        } else if constexpr (std::is_same_v<T, WhileStmt>) {
+            encode_tag('w', encoding);
+            const uint64_t condition = hash_expr(*node.condition, encoding);
+            return mix(mix('w', condition), structural_hash(*node.body, encoding));
+        } else {
+            static_assert(false, "non-exhaustive visitor!");
+        }
+    }, stmt.data);
+}
+
+uint64_t structural_hash(const StmtList &stmt_list, std::string *encoding) {
+    encode_tag('[', encoding);
+    uint64_t hash = mix('[', stmt_list.statements.size());
+    for (const Stmt &stmt: stmt_list.statements) {
+        hash = mix(hash, structural_hash(stmt, encoding));
+    }
+    encode_tag(']', encoding);
+    return hash;
+}
+
+std::shared_ptr<const RegionMemoEntry> RegionMemo::find(const uint64_t hash, const std::string &encoding) {
+    std::lock_guard lock{mutex};
+    const auto it = entries.find(Key{hash, encoding});
+    if (it == entries.end()) {
+        misses++;
+        return nullptr;
+    }
+    hits++;
+    return it->second;
+}
+
+void RegionMemo::insert(const uint64_t hash, std::string encoding, std::shared_ptr<const RegionMemoEntry> entry) {
+    if (capacity == 0) {
+        return;
+    }
+    std::lock_guard lock{mutex};
+    const auto [it, inserted] = entries.try_emplace(Key{hash, std::move(encoding)}, std::move(entry));
+    if (!inserted) {
+        return;
+    }
+    insertion_order.push_back(&it->first);
+    if (insertion_order.size() > capacity) {
+        entries.erase(*insertion_order.front());
+        insertion_order.pop_front();
+    }
+}
+
+// The assignments of a statement in source order, which is how memo entries number them.
+struct AssignmentCollector : public StaticAstVisitor<AssignmentCollector> {
+    std::vector<const AssignmentStmt *> assignments;
+
+    void visit_assignment_stmt(const AssignmentStmt &assignment_stmt) {
+        assignments.push_back(&assignment_stmt);
+        walk_assignment_stmt(assignment_stmt);
+    }
+};
+
+static std::vector<const AssignmentStmt *> collect_assignments(const Program &region) {
+    AssignmentCollector collector;
+    collector.visit_program(region);
+    return std::move(collector.assignments);
+}
+
+static std::vector<uint32_t> assignment_ordinals(const DfgNodeUnusedAssignments &unused_assignments,
+                                                 const std::vector<const AssignmentStmt *> &assignments) {
+    std::vector<uint32_t> ordinals;
+    for (const auto &assignment: unused_assignments.assignments) {
+        const auto it = std::ranges::find(assignments, assignment->span.start, [](const AssignmentStmt *stmt) {
+            return stmt->span.start;
+        });
+        ordinals.push_back(static_cast<uint32_t>(it - assignments.begin()));
+    }
+    std::ranges::sort(ordinals);
+    return ordinals;
+}
+
+// Builds and folds the statement from `constants`, leaving the constants after it there, and summarises it.
+static std::shared_ptr<const RegionMemoEntry> summarise_region(const Program &region, const std::set<char> &names,
+                                                               const bool successor_analysed,
+                                                               ConstantState &constants) {
+    TraceScope trace{"summarise_region"};
+    Cfg cfg = build_cfg(region);
+    fold_constant_branches(cfg, constants);
+    const Dfg dfg = build_dfg(cfg);
+    DfgNodeOutputs outputs{names};
+    outputs.out.insert(other_variable);
+    DfgNodeUnusedAssignments unused_all;
+    DfgNodeInputs live_in_all;
+    analyse_dfg_region(dfg, outputs, DfgNodeInputs{outputs.out}, successor_analysed, unused_all, live_in_all);
+    DfgNodeUnusedAssignments unused_none;
+    DfgNodeInputs live_in_none;
+    analyse_dfg_region(dfg, outputs, DfgNodeInputs{}, successor_analysed, unused_none, live_in_none);
+
+    const std::vector<const AssignmentStmt *> assignments = collect_assignments(region);
+    auto entry = std::make_shared<RegionMemoEntry>();
+    entry->live_in_all = std::move(live_in_all.in);
+    entry->unused_all = assignment_ordinals(unused_all, assignments);
+    entry->live_in_none = std::move(live_in_none.in);
+    entry->unused_none = assignment_ordinals(unused_none, assignments);
+    for (const char name: names) {
+        if (const auto it = constants.values.find(name); it != constants.values.end()) {
+            entry->constants_out.insert(*it);
+        }
+    }
+    return entry;
+}
+
+std::vector<UnusedAssignment> analyse_source_memoized(const std::string_view src, RegionMemo &memo) {
+    TraceScope trace{"analyse_source_memoized"};
+    ParserState state{Lexer{src}};
+    const Program program = parse_program(state);
+    DfgNodeOutputs outputs;
+    compute_whole_program_required_outputs(program, outputs);
+
+    const std::vector<Stmt> &statements = program.statements.statements;
+    const size_t n = statements.size();
+    std::vector<Program> regions(n);
+    std::vector<std::set<char>> names(n);
+    std::vector<std::shared_ptr<const RegionMemoEntry>> summaries(n);
+    ConstantState constants;
+    std::string encoding;
+    for (size_t i = 0; i < n; i++) {
+        regions[i].statements.statements.push_back(statements[i]);
+        DfgNodeOutputs region_names;
+        compute_whole_program_required_outputs(regions[i], region_names);
+        names[i] = std::move(region_names.out);
+
+        // besides the structure, the summary depends on the constants its branches are folded with, and on
+        // whether it is analysed from the program exit
+        encoding.clear();
+        uint64_t hash = structural_hash(statements[i], &encoding);
+        encoding.push_back('|');
+        for (const char name: names[i]) {
+            if (const auto it = constants.values.find(name); it != constants.values.end()) {
+                encoding.push_back(name);
+                encoding.append(std::to_string(it->second));
+                encoding.push_back(';');
+                hash = mix(mix(hash, static_cast<unsigned char>(name)), static_cast<uint32_t>(it->second));
+            }
+        }
+        const bool successor_analysed = i + 1 < n;
+        encoding.push_back(successor_analysed ? 's' : 'e');
+        hash = mix(hash, successor_analysed);
+
+        summaries[i] = memo.find(hash, encoding);
+        if (summaries[i] == nullptr) {
+            summaries[i] = summarise_region(regions[i], names[i], successor_analysed, constants);
+            memo.insert(hash, encoding, summaries[i]);
+            continue;
+        }
+        for (const char name: names[i]) {
+            constants.values.erase(name);
+        }
+        constants.values.insert(summaries[i]->constants_out.begin(), summaries[i]->constants_out.end());
+    }
+
+    // backwards, picking from the summaries by what is required after each statement, see RegionSummary
+    std::vector<UnusedAssignment> result;
+    std::set<char> live = outputs.out;
+    for (size_t i = n; i-- > 0;) {
+        const RegionMemoEntry &entry = *summaries[i];
+        if (!entry.unused_all.empty() || !entry.unused_none.empty()) {
+            const std::vector<const AssignmentStmt *> assignments = collect_assignments(regions[i]);
+            const auto add = [&](const std::vector<uint32_t> &ordinals, const bool required) {
+                for (const uint32_t ordinal: ordinals) {
+                    const AssignmentStmt &assignment = *assignments[ordinal];
+                    if (live.contains(assignment.lhs.name[0]) != required) {
+                        continue;
+                    }
+                    const auto [line, column] = state.lexer.lines.locate(assignment.span.start);
+                    result.push_back(UnusedAssignment{
+                            .name = assignment.lhs.name,
+                            .start = assignment.span.start,
+                            .end = assignment.span.end,
+                            .line = line,
+                            .column = column,
+                    });
+                }
+            };
+            add(entry.unused_all, true);
+            add(entry.unused_none, false);
+        }
+        std::set<char> live_in;
+        for (const char name: outputs.out) {
+            const std::set<char> &from = live.contains(name) ? entry.live_in_all : entry.live_in_none;
+            if (from.contains(names[i].contains(name) ? name : other_variable)) {
+                live_in.insert(name);
+            }
+        }
+        live = std::move(live_in);
+    }
+    std::ranges::sort(result, {}, &UnusedAssignment::start);
+    return result;
+}
@@ -0,0 +1,82 @@
+#ifndef DFA_SAMPLE_REGION_MEMO_HPP
+#define DFA_SAMPLE_REGION_MEMO_HPP
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "analysis.hpp"
+#include "ast.hpp"
+
+// The structure of a statement list: statement kinds, operators, names and constants, but no spans, so copies
+// of the same code anywhere hash the same. Merkle-style, from the hashes of the statements, the nested lists and
+// the expressions in them. If `encoding` is given, the same structure is appended to it, which tells structures
+// with the same hash apart.
+uint64_t structural_hash(const StmtList &stmt_list, std::string *encoding = nullptr);
+uint64_t structural_hash(const Stmt &stmt, std::string *encoding = nullptr);
+
+// The summary of one top-level statement, in the form of RegionSummary, over the variables it mentions and one
+// variable it does not, which stands for all the others. Unused assignments are numbered in source order within
+// the statement, so that they can be found in any copy of it. Folding only changes the constants a statement
+// assigns, so its effect on them is kept too, and a statement found in the memo is not built at all.
+struct RegionMemoEntry {
+    std::set<char> live_in_all;
+    std::vector<uint32_t> unused_all;
+    std::set<char> live_in_none;
+    std::vector<uint32_t> unused_none;
+    // the constants among the names the statement mentions after it
+    std::map<char, int32_t> constants_out;
+};
+
+// Summaries of top-level statements by their structure, the constants they start from and whether they are the
+// last statement, shared by any number of files and threads. Entries are evicted oldest first.
+class RegionMemo {
+    struct Key {
+        uint64_t hash;
+        std::string encoding;
+
+        bool operator==(const Key &other) const = default;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const {
+            return key.hash;
+        }
+    };
+
+    std::mutex mutex;
+    std::unordered_map<Key, std::shared_ptr<const RegionMemoEntry>, KeyHash> entries;
+    std::deque<const Key *> insertion_order;
+    size_t capacity;
+    std::atomic<size_t> hits = 0;
+    std::atomic<size_t> misses = 0;
+
+public:
+    explicit RegionMemo(const size_t capacity) : capacity(capacity) {
+    }
+
+    // the hash only narrows it down, the encoding decides
+    std::shared_ptr<const RegionMemoEntry> find(uint64_t hash, const std::string &encoding);
+
+    void insert(uint64_t hash, std::string encoding, std::shared_ptr<const RegionMemoEntry> entry);
+
+    [[nodiscard]] size_t hit_count() const {
+        return hits;
+    }
+
+    [[nodiscard]] size_t miss_count() const {
+        return misses;
+    }
+};
+
+// Produces the same results as analyse_source, analysing each top-level statement on its own like
+// analyse_source_parallel does, but taking the summaries of statements seen before from `memo`.
+std::vector<UnusedAssignment> analyse_source_memoized(std::string_view src, RegionMemo &memo);
+
+#endif //DFA_SAMPLE_REGION_MEMO_HPP
@@ -0,0 +1,258 @@
+#include "reporter.hpp"
+#include <cerrno>
+#include <charconv>
+#include <unistd.h>
+
+ReportBuffer::ReportBuffer(const int fd, const size_t flush_threshold) : fd(fd), flush_threshold(flush_threshold) {
+    if (fd >= 0) {
+        data.reserve(flush_threshold + (flush_threshold >> 2));
+    }
+}
+
+ReportBuffer::~ReportBuffer() {
+    flush();
+}
+
+void ReportBuffer::append_number(const size_t value) {
+    char digits[20];
+    const auto result = std::to_chars(std::begin(digits), std::end(digits), value);
+    data.append(digits, result.ptr);
+    flush_if_full();
+}
+
+void ReportBuffer::append_json_escaped(const std::string_view s) {
+    static constexpr char hex[] = "0123456789abcdef";
+    size_t run_start = 0;
+    for (size_t i = 0; i < s.size(); i++) {
+        const auto c = static_cast<unsigned char>(s[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        data.append(s.substr(run_start, i - run_start));
+        run_start = i + 1;
+        switch (c) {
+            case '"':
+                data.append("\\\"");
+                break;
+            case '\\':
+                data.append("\\\\");
+                break;
+            case '\n':
+                data.append("\\n");
+                break;
+            case '\r':
+                data.append("\\r");
+                break;
+            case '\t':
+                data.append("\\t");
+                break;
+            default:
+                data.append("\\u00");
+                data.push_back(hex[c >> 4]);
+                data.push_back(hex[c & 0xf]);
+                break;
+        }
+    }
+    data.append(s.substr(run_start));
+    flush_if_full();
+}
+
+bool ReportBuffer::flush() {
+    if (fd < 0) {
+        return true;
+    }
+    size_t written = 0;
+    while (write_error == 0 && written < data.size()) {
+        const ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            write_error = n < 0 ? errno : EIO;
+            break;
+        }
+        written += n;
+    }
+    data.clear();
+    return write_error == 0;
+}
+
+bool parse_report_format(const std::string_view name, ReportFormat &format) {
+    if (name == "text") {
+        format = ReportFormat::Text;
+    } else if (name == "jsonl") {
+        format = ReportFormat::JsonLines;
+    } else if (name == "sarif") {
+        format = ReportFormat::Sarif;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+class TextReporter final : public Reporter {
+    bool file_headers;
+
+public:
+    explicit TextReporter(const bool file_headers) : file_headers(file_headers) {
+    }
+
+    void begin_file(ReportBuffer &out, const std::string_view file_path, const std::string_view file_src) override {
+        Reporter::begin_file(out, file_path, file_src);
+        if (file_headers) {
+            out.append("== ");
+            out.append(path);
+            out.append('\n');
+        }
+    }
+
+    void unused_assignment(ReportBuffer &out, const UnusedAssignment &assignment) override {
+        out.append("Unused assignment to ");
+        out.append(assignment.name);
+        out.append(" at ");
+        out.append_number(assignment.start);
+        out.append("..");
+        out.append_number(assignment.end);
+        out.append(" (");
+        out.append_number(assignment.line);
+        out.append(':');
+        out.append_number(assignment.column);
+        out.append(")\n");
+        out.append(src.substr(assignment.start, assignment.end - assignment.start));
+        out.append('\n');
+    }
+
+    void error(ReportBuffer &out, const std::string_view message) override {
+        out.append("error: ");
+        out.append(message);
+        out.append('\n');
+    }
+};
+
+// One JSON object per line, each one complete with the file it is about.
+class JsonLinesReporter final : public Reporter {
+    void begin_record(ReportBuffer &out) const {
+        out.append('{');
+        if (!path.empty()) {
+            out.append("\"file\":");
+            out.append_json_string(path);
+            out.append(',');
+        }
+    }
+
+public:
+    void unused_assignment(ReportBuffer &out, const UnusedAssignment &assignment) override {
+        begin_record(out);
+        out.append("\"kind\":\"unused_assignment\",\"name\":");
+        out.append_json_string(assignment.name);
+        out.append(",\"start\":");
+        out.append_number(assignment.start);
+        out.append(",\"end\":");
+        out.append_number(assignment.end);
+        out.append(",\"line\":");
+        out.append_number(assignment.line);
+        out.append(",\"column\":");
+        out.append_number(assignment.column);
+        out.append(",\"snippet\":");
+        out.append_json_string(src.substr(assignment.start, assignment.end - assignment.start));
+        out.append("}\n");
+    }
+
+    void error(ReportBuffer &out, const std::string_view message) override {
+        begin_record(out);
+        out.append("\"kind\":\"error\",\"message\":");
+        out.append_json_string(message);
+        out.append("}\n");
+    }
+};
+
+// A single SARIF 2.1.0 log with one run, streamed out result by result.
+class SarifReporter final : public Reporter {
+    bool any_results = false;
+
+    void begin_result(ReportBuffer &out) {
+        if (any_results) {
+            out.append(",\n");
+        }
+        any_results = true;
+    }
+
+    void append_artifact_location(ReportBuffer &out) const {
+        out.append("\"artifactLocation\":{\"uri\":");
+        out.append_json_string(path);
+        out.append('}');
+    }
+
+public:
+    void begin_run(ReportBuffer &out) override {
+        out.append("{\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\",\"version\":\"2.1.0\",");
+        out.append("\"runs\":[{\"tool\":{\"driver\":{\"name\":\"dfa_sample\",\"rules\":[");
+        out.append("{\"id\":\"unused-assignment\",");
+        out.append("\"shortDescription\":{\"text\":\"Assigned value is never read\"}},");
+        out.append("{\"id\":\"analysis-error\",");
+        out.append("\"shortDescription\":{\"text\":\"File could not be analysed\"}}]}},");
+        out.append("\"results\":[\n");
+    }
+
+    void unused_assignment(ReportBuffer &out, const UnusedAssignment &assignment) override {
+        begin_result(out);
+        out.append("{\"ruleId\":\"unused-assignment\",\"level\":\"warning\",");
+        out.append("\"message\":{\"text\":\"Unused assignment to ");
+        out.append_json_escaped(assignment.name);
+        out.append("\"},\"locations\":[{\"physicalLocation\":{");
+        append_artifact_location(out);
+        out.append(",\"region\":{\"startLine\":");
+        out.append_number(assignment.line);
+        out.append(",\"startColumn\":");
+        out.append_number(assignment.column);
+        out.append(",\"charOffset\":");
+        out.append_number(assignment.start);
+        out.append(",\"charLength\":");
+        out.append_number(assignment.end - assignment.start);
+        out.append(",\"snippet\":{\"text\":");
+        out.append_json_string(src.substr(assignment.start, assignment.end - assignment.start));
+        out.append("}}}}]}");
+    }
+
+    void error(ReportBuffer &out, const std::string_view message) override {
+        begin_result(out);
+        out.append("{\"ruleId\":\"analysis-error\",\"level\":\"error\",\"message\":{\"text\":");
+        out.append_json_string(message);
+        out.append("},\"locations\":[{\"physicalLocation\":{");
+        append_artifact_location(out);
+        out.append("}}]}");
+    }
+
+    void append_file(ReportBuffer &out, const std::string_view formatted_file) override {
+        if (formatted_file.empty()) {
+            return;
+        }
+        begin_result(out);
+        out.append(formatted_file);
+    }
+
+    void end_run(ReportBuffer &out) override {
+        out.append("\n]}]}\n");
+    }
+};
+
+std::unique_ptr<Reporter> make_reporter(const ReportFormat format, const bool file_headers) {
+    switch (format) {
+        case ReportFormat::Text:
+            return std::make_unique<TextReporter>(file_headers);
+        case ReportFormat::JsonLines:
+            return std::make_unique<JsonLinesReporter>();
+        case ReportFormat::Sarif:
+            return std::make_unique<SarifReporter>();
+    }
+    throw std::runtime_error("Unknown report format");
+}
+
+void report_file(Reporter &reporter, ReportBuffer &out, const std::string_view path, const std::string_view src,
+                 const std::vector<UnusedAssignment> &unused_assignments) {
+    reporter.begin_file(out, path, src);
+    for (const auto &assignment: unused_assignments) {
+        reporter.unused_assignment(out, assignment);
+    }
+    reporter.end_file(out);
+}
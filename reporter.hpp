@@ -0,0 +1,116 @@
+#ifndef DFA_SAMPLE_REPORTER_HPP
+#define DFA_SAMPLE_REPORTER_HPP
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include "analysis.hpp"
+
+// Collects output in memory and, when given a file descriptor, writes it out in large chunks.
+class ReportBuffer {
+    std::string data;
+    int fd;
+    size_t flush_threshold;
+    // the errno of the first write that failed, or 0
+    int write_error = 0;
+
+    void flush_if_full() {
+        if (fd >= 0 && data.size() >= flush_threshold) {
+            flush();
+        }
+    }
+
+public:
+    explicit ReportBuffer(int fd = -1, size_t flush_threshold = 1 << 20);
+    ReportBuffer(const ReportBuffer &) = delete;
+    ReportBuffer &operator=(const ReportBuffer &) = delete;
+    ~ReportBuffer();
+
+    void append(std::string_view s) {
+        data.append(s);
+        flush_if_full();
+    }
+
+    void append(const char c) {
+        data.push_back(c);
+        flush_if_full();
+    }
+
+    void append_number(size_t value);
+
+    // appends `s` escaped for use inside a JSON string
+    void append_json_escaped(std::string_view s);
+
+    // appends `s` as a quoted JSON string
+    void append_json_string(const std::string_view s) {
+        data.push_back('"');
+        append_json_escaped(s);
+        data.push_back('"');
+        flush_if_full();
+    }
+
+    // Writes out everything appended so far. Once a write fails, the rest of the output is dropped, since it
+    // would only follow a gap, and this returns false from then on.
+    bool flush();
+
+    // the errno of the write that failed
+    [[nodiscard]] int error() const {
+        return write_error;
+    }
+
+    // everything appended so far, for buffers without a file descriptor
+    std::string take() {
+        return std::move(data);
+    }
+};
+
+enum class ReportFormat {
+    Text,
+    JsonLines,
+    Sarif,
+};
+
+bool parse_report_format(std::string_view name, ReportFormat &format);
+
+// Formats results one at a time, straight from the source they point into. A run covers any number of files;
+// when files are formatted separately (on different threads, say), each one gets its own reporter, and the
+// results are put together with append_file on the reporter of the run.
+class Reporter {
+protected:
+    std::string_view path;
+    std::string_view src;
+
+public:
+    virtual ~Reporter() = default;
+
+    virtual void begin_run(ReportBuffer &) {
+    }
+
+    virtual void begin_file(ReportBuffer &, const std::string_view file_path, const std::string_view file_src) {
+        path = file_path;
+        src = file_src;
+    }
+
+    virtual void unused_assignment(ReportBuffer &out, const UnusedAssignment &assignment) = 0;
+
+    virtual void error(ReportBuffer &out, std::string_view message) = 0;
+
+    virtual void end_file(ReportBuffer &) {
+    }
+
+    virtual void append_file(ReportBuffer &out, const std::string_view formatted_file) {
+        out.append(formatted_file);
+    }
+
+    virtual void end_run(ReportBuffer &) {
+    }
+};
+
+// `file_headers` makes the text format start each file with its path, as is needed with more than one file.
+std::unique_ptr<Reporter> make_reporter(ReportFormat format, bool file_headers);
+
+// Reports the results of one file.
+void report_file(Reporter &reporter, ReportBuffer &out, std::string_view path, std::string_view src,
+                 const std::vector<UnusedAssignment> &unused_assignments);
+
+#endif //DFA_SAMPLE_REPORTER_HPP
@@ -0,0 +1,389 @@
+#include "server.hpp"
+#include <algorithm>
+#include <climits>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "analysis.hpp"
+#include "reporter.hpp"
+
+// Both requests and responses are a tag byte, a native endian 64-bit payload length, and the payload. A client
+// may send any number of requests over one connection. The payload of a request starts with a byte for the
+// ReportFormat of the response.
+enum RequestKind : char {
+    // the payload is the absolute path of a file for the server to read
+    FileRequest = 'F',
+    // the payload is the source itself
+    SourceRequest = 'S',
+};
+
+enum ResponseStatus : char {
+    // the payload is the report, as printed by a local run
+    OkResponse = 'O',
+    // the payload is an error message
+    ErrorResponse = 'E',
+};
+
+static bool read_all(const int fd, char *data, size_t size) {
+    while (size > 0) {
+        const ssize_t n = read(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool write_all(const int fd, const char *data, size_t size) {
+    while (size > 0) {
+        const ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Requests are refused beyond this; spans limit sources to 4 GiB anyway, see Span.
+static constexpr uint64_t max_request_size = uint64_t{1} << 30;
+
+enum class ReadStatus {
+    Ok,
+    // the connection ended between messages
+    Closed,
+    // the connection ended in the middle of a message
+    Truncated,
+    TooLarge,
+};
+
+static ReadStatus read_message(const int fd, char &tag, std::string &payload, const uint64_t max_size) {
+    uint64_t size;
+    if (!read_all(fd, &tag, 1)) {
+        return ReadStatus::Closed;
+    }
+    if (!read_all(fd, reinterpret_cast<char *>(&size), sizeof(size))) {
+        return ReadStatus::Truncated;
+    }
+    if (size > max_size) {
+        return ReadStatus::TooLarge;
+    }
+    // grown as the bytes come in, so that a length the sender never fills costs nothing
+    static constexpr size_t chunk_size = 1 << 20;
+    payload.clear();
+    while (payload.size() < size) {
+        const size_t read_size = static_cast<size_t>(std::min<uint64_t>(size - payload.size(), chunk_size));
+        const size_t offset = payload.size();
+        payload.resize(offset + read_size);
+        if (!read_all(fd, payload.data() + offset, read_size)) {
+            return ReadStatus::Truncated;
+        }
+    }
+    return ReadStatus::Ok;
+}
+
+static bool write_message(const int fd, const char tag, const std::string_view payload) {
+    const uint64_t size = payload.size();
+    char header[1 + sizeof(size)];
+    header[0] = tag;
+    std::memcpy(header + 1, &size, sizeof(size));
+    return write_all(fd, header, sizeof(header)) && write_all(fd, payload.data(), payload.size());
+}
+
+static bool read_source_file(const std::string &path, std::string &src) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st{};
+    bool ok = fstat(fd, &st) == 0;
+    if (ok) {
+        src.resize(st.st_size);
+        ok = read_all(fd, src.data(), src.size());
+    }
+    close(fd);
+    return ok;
+}
+
+static uint64_t content_hash(const std::string_view src) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (const char c: src) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+struct CachedAnalysis {
+    std::string src;
+    // the names point into `src`
+    std::vector<UnusedAssignment> unused_assignments;
+};
+
+// Inline sources are cached with an empty path. Entries are evicted oldest first.
+class AnalysisCache {
+    using Key = std::pair<std::string, uint64_t>;
+
+    std::mutex mutex;
+    std::map<Key, std::shared_ptr<const CachedAnalysis>> entries;
+    std::deque<Key> insertion_order;
+    size_t capacity;
+
+public:
+    explicit AnalysisCache(const size_t capacity) : capacity(capacity) {
+    }
+
+    std::shared_ptr<const CachedAnalysis> find(const std::string &path, const uint64_t hash,
+                                               const std::string_view src) {
+        std::lock_guard lock{mutex};
+        const auto it = entries.find(Key{path, hash});
+        // the hash only narrows it down, the contents decide
+        if (it == entries.end() || it->second->src != src) {
+            return nullptr;
+        }
+        return it->second;
+    }
+
+    void insert(const std::string &path, const uint64_t hash, std::shared_ptr<const CachedAnalysis> analysis) {
+        if (capacity == 0) {
+            return;
+        }
+        std::lock_guard lock{mutex};
+        const auto [it, inserted] = entries.insert_or_assign(Key{path, hash}, std::move(analysis));
+        if (!inserted) {
+            return;
+        }
+        insertion_order.push_back(it->first);
+        if (insertion_order.size() > capacity) {
+            entries.erase(insertion_order.front());
+            insertion_order.pop_front();
+        }
+    }
+};
+
+static std::shared_ptr<const CachedAnalysis> analyse_cached(AnalysisCache &cache, const std::string &path,
+                                                            std::string src) {
+    const uint64_t hash = content_hash(src);
+    if (auto cached = cache.find(path, hash, src)) {
+        return cached;
+    }
+
+    auto analysis = std::make_shared<CachedAnalysis>();
+    analysis->src = std::move(src);
+    analysis->unused_assignments = analyse_source(analysis->src);
+    cache.insert(path, hash, analysis);
+    return analysis;
+}
+
+// Formats the results like a local run of the client would.
+static std::string format_response(const ReportFormat format, const std::string_view path,
+                                   const CachedAnalysis &analysis) {
+    ReportBuffer response;
+    const std::unique_ptr<Reporter> reporter = make_reporter(format, false);
+    reporter->begin_run(response);
+    report_file(*reporter, response, path, analysis.src, analysis.unused_assignments);
+    reporter->end_run(response);
+    return response.take();
+}
+
+static void serve_connection(const int fd, AnalysisCache &cache) {
+    char tag;
+    std::string payload;
+    bool open = true;
+    while (open) {
+        bool sent;
+        try {
+            switch (read_message(fd, tag, payload, max_request_size)) {
+                case ReadStatus::Ok:
+                    break;
+                case ReadStatus::Closed:
+                    open = false;
+                    continue;
+                case ReadStatus::Truncated:
+                    // there is no telling where the next message would start
+                    open = false;
+                    throw std::runtime_error("Truncated request");
+                case ReadStatus::TooLarge:
+                    open = false;
+                    throw std::runtime_error("Request too large");
+            }
+            if (payload.empty() || static_cast<unsigned char>(payload[0]) > static_cast<int>(ReportFormat::Sarif)) {
+                throw std::runtime_error("Invalid report format");
+            }
+            const auto format = static_cast<ReportFormat>(payload[0]);
+            payload.erase(0, 1);
+            std::shared_ptr<const CachedAnalysis> analysis;
+            std::string path;
+            if (tag == FileRequest) {
+                std::string src;
+                if (!read_source_file(payload, src)) {
+                    throw std::runtime_error("Failed to open file " + payload);
+                }
+                path = payload;
+                analysis = analyse_cached(cache, path, std::move(src));
+            } else if (tag == SourceRequest) {
+                analysis = analyse_cached(cache, "", std::move(payload));
+            } else {
+                throw std::runtime_error("Unknown request");
+            }
+            sent = write_message(fd, OkResponse, format_response(format, path, *analysis));
+        } catch (const std::exception &e) {
+            // bad_alloc included, which only ends this connection
+            sent = write_message(fd, ErrorResponse, e.what());
+        }
+        if (!sent) {
+            break;
+        }
+    }
+    close(fd);
+}
+
+static bool make_address(const char *socket_path, sockaddr_un &address) {
+    address = sockaddr_un{};
+    address.sun_family = AF_UNIX;
+    if (std::strlen(socket_path) >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long: " << socket_path << std::endl;
+        return false;
+    }
+    std::strcpy(address.sun_path, socket_path);
+    return true;
+}
+
+// Removes a socket left behind by a server that is no longer running, which would make bind fail. Anything else
+// at the path, a file or the socket of a server still accepting connections, is left alone.
+static bool remove_stale_socket(const char *socket_path, const sockaddr_un &address) {
+    struct stat st{};
+    if (lstat(socket_path, &st) != 0) {
+        if (errno == ENOENT) {
+            return true;
+        }
+        std::cerr << "Failed to stat " << socket_path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        std::cerr << "Not a socket, refusing to replace it: " << socket_path << std::endl;
+        return false;
+    }
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "Failed to create socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    const bool refused = connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0
+                         && errno == ECONNREFUSED;
+    close(fd);
+    if (!refused) {
+        std::cerr << "A server is already listening on " << socket_path << std::endl;
+        return false;
+    }
+    if (unlink(socket_path) != 0) {
+        std::cerr << "Failed to remove " << socket_path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int run_server(const char *socket_path, const size_t cache_entries) {
+    sockaddr_un address;
+    if (!make_address(socket_path, address)) {
+        return 1;
+    }
+    if (!remove_stale_socket(socket_path, address)) {
+        return 1;
+    }
+    const int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        std::cerr << "Failed to create socket: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    if (bind(listen_fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0
+        || listen(listen_fd, SOMAXCONN) != 0) {
+        std::cerr << "Failed to listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+        close(listen_fd);
+        return 1;
+    }
+    // clients going away mid-response must not take the server down
+    std::signal(SIGPIPE, SIG_IGN);
+
+    AnalysisCache cache{cache_entries};
+    while (true) {
+        const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            std::cerr << "Failed to accept connection: " << std::strerror(errno) << std::endl;
+            close(listen_fd);
+            return 1;
+        }
+        std::thread(serve_connection, fd, std::ref(cache)).detach();
+    }
+}
+
+int run_client(const char *socket_path, const char *path, const ReportFormat format) {
+    std::string payload(1, static_cast<char>(format));
+    RequestKind kind;
+    if (path != nullptr) {
+        // the server resolves paths relative to its own working directory
+        char resolved[PATH_MAX];
+        if (realpath(path, resolved) == nullptr) {
+            std::cerr << "Failed to open file " << path << std::endl;
+            return 1;
+        }
+        payload += resolved;
+        kind = FileRequest;
+    } else {
+        char buffer[1 << 16];
+        ssize_t n;
+        while ((n = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0) {
+            payload.append(buffer, n);
+        }
+        kind = SourceRequest;
+    }
+
+    sockaddr_un address;
+    if (!make_address(socket_path, address)) {
+        return 1;
+    }
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+        std::cerr << "Failed to connect to " << socket_path << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 1;
+    }
+
+    char status;
+    std::string response;
+    const bool ok = write_message(fd, kind, payload)
+                    && read_message(fd, status, response, UINT64_MAX) == ReadStatus::Ok;
+    close(fd);
+    if (!ok) {
+        std::cerr << "Lost connection to " << socket_path << std::endl;
+        return 1;
+    }
+    if (status != OkResponse) {
+        std::cerr << response << std::endl;
+        return 1;
+    }
+    return write_all(STDOUT_FILENO, response.data(), response.size()) ? 0 : 1;
+}
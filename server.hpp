@@ -0,0 +1,16 @@
+#ifndef DFA_SAMPLE_SERVER_HPP
+#define DFA_SAMPLE_SERVER_HPP
+
+#include <cstddef>
+#include "reporter.hpp"
+
+// Listens on the Unix domain socket at `socket_path` and answers analysis requests until killed. Results are
+// cached in memory by file path and content hash, at most `cache_entries` of them. A socket a stopped server left
+// at the path is replaced; if anything else is there, or a server still listens on it, returns 1 right away.
+int run_server(const char *socket_path, size_t cache_entries);
+
+// Sends one request to the server at `socket_path` and prints the answer in `format` like a local run would.
+// Analyses the file at `path`, or the source read from stdin if it is null.
+int run_client(const char *socket_path, const char *path, ReportFormat format);
+
+#endif //DFA_SAMPLE_SERVER_HPP
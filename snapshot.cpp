@@ -0,0 +1,233 @@
+#include "snapshot.hpp"
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include "cfg.hpp"
+#include "constant_propagation.hpp"
+#include "dfg.hpp"
+#include "dfg_analysis.hpp"
+#include "intern.hpp"
+#include "trace.hpp"
+
+bool AnalysisSnapshot::contains(const std::vector<uint64_t> &sets, const size_t index, const char name) const {
+    const uint16_t bit = variable_bits[static_cast<unsigned char>(name)];
+    if (bit == 0) {
+        return false;
+    }
+    // bits are stored off by one, so that 0 is no variable
+    return (sets[index * words + (bit - 1) / 64] >> ((bit - 1) % 64) & 1) != 0;
+}
+
+void AnalysisSnapshot::append_names(const std::vector<uint64_t> &sets, const size_t index,
+                                    std::string &names) const {
+    for (size_t i = 0; i < variables.size(); i++) {
+        if ((sets[index * words + i / 64] >> (i % 64) & 1) != 0) {
+            names.push_back(variables[i]);
+        }
+    }
+}
+
+bool AnalysisSnapshot::live_in(const uint32_t node, const char name) const {
+    return contains(node_live_in, node, name);
+}
+
+bool AnalysisSnapshot::live_out(const uint32_t node, const char name) const {
+    return contains(node_live_out, node, name);
+}
+
+std::optional<uint32_t> AnalysisSnapshot::point_at(const size_t offset) const {
+    // points never overlap, so the only candidate is the last one starting at or before `offset`
+    const auto it = std::ranges::upper_bound(points, offset, {}, &Point::start);
+    if (it == points.begin() || offset >= std::prev(it)->end) {
+        return std::nullopt;
+    }
+    return static_cast<uint32_t>(std::prev(it) - points.begin());
+}
+
+bool AnalysisSnapshot::live_before(const uint32_t point, const char name) const {
+    return contains(point_live_in, point, name);
+}
+
+bool AnalysisSnapshot::live_after(const uint32_t point, const char name) const {
+    return contains(point_live_out, point, name);
+}
+
+void AnalysisSnapshot::live_before(const uint32_t point, std::string &names) const {
+    append_names(point_live_in, point, names);
+}
+
+void AnalysisSnapshot::live_after(const uint32_t point, std::string &names) const {
+    append_names(point_live_out, point, names);
+}
+
+std::span<const UnusedAssignment> AnalysisSnapshot::unused_assignments(const size_t start, const size_t end) const {
+    // assignments do not nest, so their ends are sorted too
+    const auto first = std::ranges::upper_bound(unused, start, {}, &UnusedAssignment::end);
+    const auto last = std::lower_bound(first, unused.end(), end, [](const UnusedAssignment &assignment,
+                                                                    const size_t offset) {
+        return assignment.start < offset;
+    });
+    return {first, last};
+}
+
+std::optional<size_t> AnalysisSnapshot::offset_of(const size_t line, const size_t column) const {
+    if (line == 0 || line > lines.line_starts.size() || column == 0) {
+        return std::nullopt;
+    }
+    return lines.line_starts[line - 1] + column - 1;
+}
+
+// From the first character of `expr` to its last. The span of a binary expression itself starts at its operator
+// and takes in the whitespace after it, so it is made up from the ones of its operands.
+static Span condition_span(const Expr &expr) {
+    if (const auto *binary_expr = std::get_if<BinaryExpr>(&expr.data)) {
+        return Span{condition_span(*binary_expr->lhs).start, condition_span(*binary_expr->rhs).end};
+    }
+    return expr_span(expr);
+}
+
+// Writes sets of names as bits, `words` per set.
+class SetWriter {
+    const std::array<uint16_t, 256> &bits;
+    size_t words;
+
+public:
+    SetWriter(const std::array<uint16_t, 256> &bits, const size_t words) : bits(bits), words(words) {
+    }
+
+    void write(const std::set<char> &set, std::vector<uint64_t> &sets, const size_t index) const {
+        for (const char name: set) {
+            const uint16_t bit = bits[static_cast<unsigned char>(name)];
+            sets[index * words + (bit - 1) / 64] |= uint64_t{1} << ((bit - 1) % 64);
+        }
+    }
+};
+
+std::shared_ptr<const AnalysisSnapshot> freeze_analysis(const std::string_view src) {
+    TraceScope trace{"freeze_analysis"};
+    ParserState state{Lexer{src}};
+    const Program program = parse_program(state);
+    Cfg cfg = build_cfg(program);
+    ConstantState constants;
+    fold_constant_branches(cfg, constants);
+    const Dfg dfg = build_dfg(cfg);
+    DfgNodeOutputs outputs;
+    compute_whole_program_required_outputs(program, outputs);
+    DfgNodeUnusedAssignments unused_assignments;
+    DfgInouts inouts;
+    analyse_dfg_inouts(dfg, outputs, unused_assignments, inouts);
+
+    auto snapshot = std::make_shared<AnalysisSnapshot>();
+    snapshot->variables.assign(outputs.out.begin(), outputs.out.end());
+    for (size_t i = 0; i < snapshot->variables.size(); i++) {
+        snapshot->variable_bits[static_cast<unsigned char>(snapshot->variables[i])] = static_cast<uint16_t>(i + 1);
+    }
+    const size_t words = snapshot->words = (snapshot->variables.size() + 63) / 64;
+    const SetWriter writer{snapshot->variable_bits, words};
+
+    const size_t node_count = dfg.nodes.size();
+    std::unordered_map<const DfgNode *, uint32_t> node_ids;
+    for (size_t i = 0; i < node_count; i++) {
+        node_ids.emplace(dfg.nodes[i].get(), static_cast<uint32_t>(i));
+    }
+    snapshot->node_live_in.resize(node_count * words);
+    snapshot->node_live_out.resize(node_count * words);
+    snapshot->successor_offsets.push_back(0);
+    std::vector<uint64_t> &point_live_in = snapshot->point_live_in;
+    std::vector<uint64_t> &point_live_out = snapshot->point_live_out;
+    for (size_t i = 0; i < node_count; i++) {
+        const DfgNode &node = *dfg.nodes[i];
+        for (const auto &out_node: node.out_nodes) {
+            snapshot->successor_targets.push_back(node_ids.at(out_node.lock().get()));
+        }
+        snapshot->successor_offsets.push_back(static_cast<uint32_t>(snapshot->successor_targets.size()));
+
+        // nodes the analysis never reached have nothing live around them
+        static const DfgNodeInout unreached;
+        const auto it = inouts.find(dfg.nodes[i].get());
+        const DfgNodeInout &inout = it != inouts.end() ? it->second : unreached;
+        writer.write(inout.inputs.in, snapshot->node_live_in, i);
+        writer.write(inout.outputs.out, snapshot->node_live_out, i);
+
+        const auto add_point = [&](const Span span, const char name, const std::set<char> &live_in,
+                                   const std::set<char> &live_out) {
+            const size_t index = snapshot->points.size();
+            snapshot->points.push_back(AnalysisSnapshot::Point{
+                    .start = span.start,
+                    .end = span.end,
+                    .node = static_cast<uint32_t>(i),
+                    .name = name,
+            });
+            point_live_in.resize((index + 1) * words);
+            point_live_out.resize((index + 1) * words);
+            writer.write(live_in, point_live_in, index);
+            writer.write(live_out, point_live_out, index);
+        };
+        snapshot->node_kinds.push_back(std::visit([&]<typename T0>(T0 &&cfg_node) -> AnalysisSnapshot::NodeKind {
+            using T = std::decay_t<T0>;
+            if constexpr (std::is_same_v<T, BasicCfgBlock>) {
+                // backwards through the block from what is required after it, like the analysis goes
+                std::set<char> live = inout.outputs.out;
+                std::vector<std::pair<std::set<char>, std::set<char>>> around(cfg_node.assignments.size());
+                for (size_t a = cfg_node.assignments.size(); a-- > 0;) {
+                    const AssignmentCfgNode &assignment = *cfg_node.assignments[a];
+                    around[a].second = live;
+                    if (it != inouts.end()) {
+                        live.erase(assignment.name.name[0]);
+                        live.insert(assignment.flat->reads.begin(), assignment.flat->reads.end());
+                    }
+                    around[a].first = live;
+                }
+                for (size_t a = 0; a < cfg_node.assignments.size(); a++) {
+                    const AssignmentCfgNode &assignment = *cfg_node.assignments[a];
+                    add_point(assignment.span, assignment.name.name[0], around[a].first, around[a].second);
+                }
+                return AnalysisSnapshot::NodeKind::BasicBlock;
+            } else if constexpr (std::is_same_v<T, IfCfgNode>) {
+                add_point(condition_span(*cfg_node.condition), '\0', inout.inputs.in, inout.outputs.out);
+                return AnalysisSnapshot::NodeKind::If;
+            } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileCfgNode>>) {
+                add_point(condition_span(*cfg_node->condition), '\0', inout.inputs.in, inout.outputs.out);
+                return AnalysisSnapshot::NodeKind::While;
+            } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileRetDummyCfgNode>>) {
+                return AnalysisSnapshot::NodeKind::WhileRetDummy;
+            } else if constexpr (std::is_same_v<T, ExitCfgNode>) {
+                return AnalysisSnapshot::NodeKind::Exit;
+            } else {
+                static_assert(false, "non-exhaustive visitor!");
+            }
+        }, node.cfg_node->node));
+    }
+
+    // into source order, moving the sets along
+    std::vector<uint32_t> order(snapshot->points.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::sort(order, {}, [&](const uint32_t p) {
+        return snapshot->points[p].start;
+    });
+    std::vector<AnalysisSnapshot::Point> points;
+    std::vector<uint64_t> sorted_live_in;
+    std::vector<uint64_t> sorted_live_out;
+    points.reserve(order.size());
+    sorted_live_in.reserve(point_live_in.size());
+    sorted_live_out.reserve(point_live_out.size());
+    for (const uint32_t p: order) {
+        points.push_back(snapshot->points[p]);
+        sorted_live_in.insert(sorted_live_in.end(), point_live_in.begin() + p * words,
+                              point_live_in.begin() + (p + 1) * words);
+        sorted_live_out.insert(sorted_live_out.end(), point_live_out.begin() + p * words,
+                               point_live_out.begin() + (p + 1) * words);
+    }
+    snapshot->points = std::move(points);
+    point_live_in = std::move(sorted_live_in);
+    point_live_out = std::move(sorted_live_out);
+
+    // with names into the snapshot rather than `src`, which it outlives
+    snapshot->unused = sorted_unused_assignments(unused_assignments, state.lexer.lines);
+    for (UnusedAssignment &assignment: snapshot->unused) {
+        const uint16_t bit = snapshot->variable_bits[static_cast<unsigned char>(assignment.name[0])];
+        assignment.name = std::string_view{&snapshot->variables[bit - 1], 1};
+    }
+    snapshot->lines = std::move(state.lexer.lines);
+    return snapshot;
+}
@@ -0,0 +1,140 @@
+#ifndef DFA_SAMPLE_SNAPSHOT_HPP
+#define DFA_SAMPLE_SNAPSHOT_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "analysis.hpp"
+#include "parse.hpp"
+
+// A finished analysis of a program, frozen into flat arrays: the DFG nodes with their successors in CSR form, and
+// the variables live before and after every node and every program point, as one bit per variable of the program.
+// The points are the assignments and the if and while conditions, in source order. The sets are the ones the
+// analysis ends with, so in nested loops an assignment it reported unused on an earlier pass may show its variable
+// live after it. Nothing in it changes after freeze_analysis builds it and it holds no shared_ptr, so any number of
+// threads can query one at once without locking and without touching reference counts.
+class AnalysisSnapshot {
+public:
+    enum class NodeKind : uint8_t {
+        BasicBlock,
+        If,
+        While,
+        WhileRetDummy,
+        Exit,
+    };
+
+    struct Point {
+        uint32_t start;
+        uint32_t end;
+        // the DFG node it belongs to
+        uint32_t node;
+        // the variable assigned, or '\0' for a condition
+        char name;
+    };
+
+private:
+    // the variables of the program, sorted; bit i of a set stands for variables[i]
+    std::vector<char> variables;
+    std::array<uint16_t, 256> variable_bits{};
+    // uint64_t words per set
+    size_t words = 0;
+
+    std::vector<NodeKind> node_kinds;
+    std::vector<uint32_t> successor_offsets;
+    std::vector<uint32_t> successor_targets;
+    std::vector<uint64_t> node_live_in;
+    std::vector<uint64_t> node_live_out;
+
+    std::vector<Point> points;
+    std::vector<uint64_t> point_live_in;
+    std::vector<uint64_t> point_live_out;
+
+    // sorted by span start, with names pointing into `variables`
+    std::vector<UnusedAssignment> unused;
+    LineIndex lines;
+
+    friend std::shared_ptr<const AnalysisSnapshot> freeze_analysis(std::string_view src);
+
+    [[nodiscard]] bool contains(const std::vector<uint64_t> &sets, size_t index, char name) const;
+    void append_names(const std::vector<uint64_t> &sets, size_t index, std::string &names) const;
+
+public:
+    [[nodiscard]] size_t node_count() const {
+        return node_kinds.size();
+    }
+
+    [[nodiscard]] NodeKind node_kind(const uint32_t node) const {
+        return node_kinds[node];
+    }
+
+    [[nodiscard]] std::span<const uint32_t> successors(const uint32_t node) const {
+        return std::span{successor_targets}.subspan(successor_offsets[node],
+                                                    successor_offsets[node + 1] - successor_offsets[node]);
+    }
+
+    // whether `name` is required on entry to or after `node`
+    [[nodiscard]] bool live_in(uint32_t node, char name) const;
+    [[nodiscard]] bool live_out(uint32_t node, char name) const;
+
+    [[nodiscard]] size_t point_count() const {
+        return points.size();
+    }
+
+    [[nodiscard]] const Point &point(const uint32_t point) const {
+        return points[point];
+    }
+
+    // the point whose span contains `offset`, if any
+    [[nodiscard]] std::optional<uint32_t> point_at(size_t offset) const;
+
+    // whether `name` is required just before or just after `point`
+    [[nodiscard]] bool live_before(uint32_t point, char name) const;
+    [[nodiscard]] bool live_after(uint32_t point, char name) const;
+    // appends the names of those variables to `names`, in order
+    void live_before(uint32_t point, std::string &names) const;
+    void live_after(uint32_t point, std::string &names) const;
+
+    // all of them, like analyse_source finds them
+    [[nodiscard]] std::span<const UnusedAssignment> unused_assignments() const {
+        return unused;
+    }
+
+    // the ones overlapping [start, end)
+    [[nodiscard]] std::span<const UnusedAssignment> unused_assignments(size_t start, size_t end) const;
+
+    [[nodiscard]] LineIndex::LineColumn locate(const size_t offset) const {
+        return lines.locate(offset);
+    }
+
+    // the offset of a 1-based line and column, if the line exists
+    [[nodiscard]] std::optional<size_t> offset_of(size_t line, size_t column) const;
+};
+
+// Parses and analyses `src` like analyse_source, and freezes the result. Throws std::runtime_error like it.
+std::shared_ptr<const AnalysisSnapshot> freeze_analysis(std::string_view src);
+
+// The snapshot currently published, replaced as a whole RCU-style: readers take the one published when they
+// acquire it and keep it alive for as long as they hold it, while a writer publishes a new one without waiting
+// for them. The previous snapshot is freed when its last reader lets go of it. Readers should acquire once for
+// a batch of queries, which is the only reference count they touch.
+class SnapshotCell {
+    std::atomic<std::shared_ptr<const AnalysisSnapshot>> current;
+
+public:
+    [[nodiscard]] std::shared_ptr<const AnalysisSnapshot> acquire() const {
+        return current.load(std::memory_order_acquire);
+    }
+
+    // returns the one it replaces
+    std::shared_ptr<const AnalysisSnapshot> publish(std::shared_ptr<const AnalysisSnapshot> snapshot) {
+        return current.exchange(std::move(snapshot), std::memory_order_acq_rel);
+    }
+};
+
+#endif //DFA_SAMPLE_SNAPSHOT_HPP
@@ -0,0 +1,261 @@
+#include "stats.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <sys/resource.h>
+#include "cfg.hpp"
+#include "constant_propagation.hpp"
+#include "dfg.hpp"
+#include "dfg_analysis.hpp"
+#include "intern.hpp"
+#include "parse.hpp"
+#include "memory.hpp"
+#include "reporter.hpp"
+
+thread_local AnalysisCounters *active_analysis_counters = nullptr;
+
+static double cpu_seconds() {
+    timespec ts{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+static size_t peak_rss_kb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Measures from construction to destruction, and adds the result to `phases`. `resource` is the counting
+// resource the phase allocates from, if any.
+class PhaseMeasurement {
+    std::vector<PhaseStats> &phases;
+    const char *name;
+    const CountingMemoryResource *resource;
+    std::chrono::steady_clock::time_point wall_start;
+    double cpu_start;
+    size_t rss_start;
+    AllocationScope allocations;
+
+public:
+    PhaseMeasurement(std::vector<PhaseStats> &phases, const char *name,
+                     const CountingMemoryResource *resource = nullptr)
+        : phases(phases), name(name), resource(resource), wall_start(std::chrono::steady_clock::now()),
+          cpu_start(cpu_seconds()), rss_start(peak_rss_kb()) {
+    }
+
+    ~PhaseMeasurement() {
+        const AllocationTotals totals = allocations.finish();
+        const AllocationTotals resource_totals = resource != nullptr ? resource->totals : AllocationTotals{};
+        phases.push_back(PhaseStats{
+                .name = name,
+                .wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count(),
+                .cpu_seconds = cpu_seconds() - cpu_start,
+                .peak_rss_delta_kb = peak_rss_kb() - rss_start,
+                .allocations = totals.allocations,
+                .allocated_bytes = totals.bytes,
+                .peak_live_bytes = totals.peak_live_bytes,
+                .resource_allocations = resource_totals.allocations,
+                .resource_bytes = resource_totals.bytes,
+                .resource_peak_live_bytes = resource_totals.peak_live_bytes,
+        });
+    }
+};
+
+struct NodeCountVisitor : public StaticAstVisitor<NodeCountVisitor> {
+    StructureStats &stats;
+
+    explicit NodeCountVisitor(StructureStats &stats) : stats(stats) {
+    }
+
+    void visit_expr(const Expr &expr) {
+        stats.ast_expressions++;
+        walk_expr(expr);
+    }
+
+    void visit_statement(const Stmt &stmt) {
+        stats.ast_statements++;
+        walk_statement(stmt);
+    }
+};
+
+static void count_graph(const Dfg &dfg, StructureStats &stats) {
+    // build_dfg makes exactly one node per CFG node that is not in a pruned branch
+    stats.dfg_nodes = dfg.nodes.size();
+    for (const auto &node: dfg.nodes) {
+        stats.dfg_edges += node->out_nodes.size();
+        std::visit([&]<typename T0>(T0 &&cfg_node) {
+            using T = std::decay_t<T0>;
+            if constexpr (std::is_same_v<T, BasicCfgBlock>) {
+                stats.cfg_basic_blocks++;
+                stats.cfg_assignments += cfg_node.assignments.size();
+            } else if constexpr (std::is_same_v<T, IfCfgNode>) {
+                stats.cfg_ifs++;
+            } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileCfgNode>>) {
+                stats.cfg_whiles++;
+            } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileRetDummyCfgNode>>) {
+                stats.cfg_while_ends++;
+            } else if constexpr (std::is_same_v<T, ExitCfgNode>) {
+                stats.cfg_exits++;
+            } else {
+                static_assert(false, "non-exhaustive visitor!");
+            }
+        }, node->cfg_node->node);
+    }
+}
+
+std::vector<UnusedAssignment> analyse_source_with_stats(const std::string_view src, AnalysisStats &stats,
+                                                        const PhaseMemory &memory, const bool hash_cons) {
+    enable_allocation_counting();
+    // declared first, the results of the phases may live in them
+    CountingMemoryResource parse_memory{memory.parse};
+    CountingMemoryResource cfg_memory{memory.cfg};
+    CountingMemoryResource dfg_memory{memory.dfg};
+    CountingMemoryResource analysis_memory{memory.analysis};
+
+    ExprInterner interner;
+    ParserState state{Lexer{src}, &parse_memory, hash_cons ? &interner : nullptr};
+    Program p;
+    {
+        PhaseMeasurement phase{stats.phases, "parse", &parse_memory};
+        p = parse_program(state);
+    }
+    Cfg cfg;
+    {
+        PhaseMeasurement phase{stats.phases, "build_cfg", &cfg_memory};
+        cfg = build_cfg(p, &cfg_memory);
+    }
+    {
+        PhaseMeasurement phase{stats.phases, "fold_branches"};
+        ConstantState constants;
+        stats.structure.folded_branches = fold_constant_branches(cfg, constants);
+    }
+    Dfg dfg;
+    {
+        PhaseMeasurement phase{stats.phases, "build_dfg", &dfg_memory};
+        dfg = build_dfg(cfg, &dfg_memory);
+    }
+    DfgNodeOutputs outputs;
+    DfgNodeUnusedAssignments unused_assignments;
+    {
+        PhaseMeasurement phase{stats.phases, "analyse_dfg", &analysis_memory};
+        compute_whole_program_required_outputs(p, outputs);
+        active_analysis_counters = &stats.counters;
+        try {
+            analyse_dfg(dfg, outputs, unused_assignments, &analysis_memory);
+        } catch (...) {
+            active_analysis_counters = nullptr;
+            throw;
+        }
+        active_analysis_counters = nullptr;
+    }
+    std::vector<UnusedAssignment> result;
+    {
+        PhaseMeasurement phase{stats.phases, "sort_results"};
+        result = sorted_unused_assignments(unused_assignments, state.lexer.lines);
+    }
+
+    NodeCountVisitor visitor{stats.structure};
+    visitor.visit_program(p);
+    count_graph(dfg, stats.structure);
+    stats.structure.intern_lookups = interner.lookups;
+    stats.structure.intern_hits = interner.hits;
+    stats.structure.intern_unique = interner.unique_expressions();
+    return result;
+}
+
+static std::vector<std::pair<const char *, size_t>> named_counters(const AnalysisStats &stats) {
+    const StructureStats &s = stats.structure;
+    const AnalysisCounters &c = stats.counters;
+    return {
+            {"ast_statements", s.ast_statements},
+            {"ast_expressions", s.ast_expressions},
+            {"cfg_basic_blocks", s.cfg_basic_blocks},
+            {"cfg_assignments", s.cfg_assignments},
+            {"cfg_ifs", s.cfg_ifs},
+            {"cfg_whiles", s.cfg_whiles},
+            {"cfg_while_ends", s.cfg_while_ends},
+            {"cfg_exits", s.cfg_exits},
+            {"dfg_nodes", s.dfg_nodes},
+            {"dfg_edges", s.dfg_edges},
+            {"folded_branches", s.folded_branches},
+            {"intern_lookups", s.intern_lookups},
+            {"intern_hits", s.intern_hits},
+            {"intern_unique", s.intern_unique},
+            {"worklist_pops", c.worklist_pops},
+            {"node_revisits", c.node_revisits},
+            {"loop_solves", c.loop_solves},
+            {"loop_body_analyses", c.loop_body_analyses},
+    };
+}
+
+std::string format_stats_text(const AnalysisStats &stats) {
+    std::string out;
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-14s %10s %10s %12s %10s %12s %12s %10s %12s %12s\n", "phase",
+                  "wall ms", "cpu ms", "peak rss kb", "allocs", "bytes", "peak live", "pmr allocs", "pmr bytes",
+                  "pmr peak");
+    out += line;
+    for (const PhaseStats &phase: stats.phases) {
+        std::snprintf(line, sizeof(line), "%-14s %10.3f %10.3f %12zu %10zu %12zu %12lld %10zu %12zu %12lld\n",
+                      phase.name, phase.wall_seconds * 1e3, phase.cpu_seconds * 1e3, phase.peak_rss_delta_kb,
+                      phase.allocations, phase.allocated_bytes, static_cast<long long>(phase.peak_live_bytes),
+                      phase.resource_allocations, phase.resource_bytes,
+                      static_cast<long long>(phase.resource_peak_live_bytes));
+        out += line;
+    }
+    for (const auto &[name, value]: named_counters(stats)) {
+        std::snprintf(line, sizeof(line), "%-20s %12zu\n", name, value);
+        out += line;
+    }
+    return out;
+}
+
+std::string format_stats_json(const AnalysisStats &stats) {
+    ReportBuffer out;
+    char seconds[32];
+    out.append("{\"phases\":[");
+    for (size_t i = 0; i < stats.phases.size(); i++) {
+        const PhaseStats &phase = stats.phases[i];
+        if (i > 0) {
+            out.append(',');
+        }
+        out.append("{\"name\":");
+        out.append_json_string(phase.name);
+        std::snprintf(seconds, sizeof(seconds), "%.9f", phase.wall_seconds);
+        out.append(",\"wall_seconds\":");
+        out.append(seconds);
+        std::snprintf(seconds, sizeof(seconds), "%.9f", phase.cpu_seconds);
+        out.append(",\"cpu_seconds\":");
+        out.append(seconds);
+        out.append(",\"peak_rss_delta_kb\":");
+        out.append_number(phase.peak_rss_delta_kb);
+        out.append(",\"allocations\":");
+        out.append_number(phase.allocations);
+        out.append(",\"allocated_bytes\":");
+        out.append_number(phase.allocated_bytes);
+        out.append(",\"peak_live_bytes\":");
+        out.append_number(std::max<int64_t>(phase.peak_live_bytes, 0));
+        out.append(",\"resource_allocations\":");
+        out.append_number(phase.resource_allocations);
+        out.append(",\"resource_bytes\":");
+        out.append_number(phase.resource_bytes);
+        out.append(",\"resource_peak_live_bytes\":");
+        out.append_number(std::max<int64_t>(phase.resource_peak_live_bytes, 0));
+        out.append('}');
+    }
+    out.append("],\"counters\":{");
+    bool first = true;
+    for (const auto &[name, value]: named_counters(stats)) {
+        if (!first) {
+            out.append(',');
+        }
+        first = false;
+        out.append_json_string(name);
+        out.append(':');
+        out.append_number(value);
+    }
+    out.append("}}\n");
+    return out.take();
+}
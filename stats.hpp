@@ -0,0 +1,81 @@
+#ifndef DFA_SAMPLE_STATS_HPP
+#define DFA_SAMPLE_STATS_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "analysis.hpp"
+
+// Events counted inside analyse_dfg. The analysis only counts while a thread has counters installed, so the
+// hooks cost a thread-local null check otherwise.
+struct AnalysisCounters {
+    // nodes taken off the worklist, including ones already visited
+    size_t worklist_pops = 0;
+    // worklist pops of nodes that had already been visited, and were skipped
+    size_t node_revisits = 0;
+    // while nodes solved, and the analyses of loop bodies that took (two per solve)
+    size_t loop_solves = 0;
+    size_t loop_body_analyses = 0;
+};
+
+extern thread_local AnalysisCounters *active_analysis_counters;
+
+inline void count_analysis_event(size_t AnalysisCounters::*counter) {
+    if (active_analysis_counters != nullptr) {
+        ++(active_analysis_counters->*counter);
+    }
+}
+
+struct PhaseStats {
+    const char *name;
+    double wall_seconds;
+    double cpu_seconds;
+    // growth of the peak resident set size over the phase
+    size_t peak_rss_delta_kb;
+    // operator new calls on the analysing thread, the bytes they asked for, and the most that was live at once
+    size_t allocations;
+    size_t allocated_bytes;
+    int64_t peak_live_bytes;
+    // the same for the memory resource of the phase, if it has one
+    size_t resource_allocations;
+    size_t resource_bytes;
+    int64_t resource_peak_live_bytes;
+};
+
+struct StructureStats {
+    size_t ast_statements = 0;
+    size_t ast_expressions = 0;
+    size_t cfg_basic_blocks = 0;
+    size_t cfg_assignments = 0;
+    size_t cfg_ifs = 0;
+    size_t cfg_whiles = 0;
+    size_t cfg_while_ends = 0;
+    size_t cfg_exits = 0;
+    size_t dfg_nodes = 0;
+    size_t dfg_edges = 0;
+    // if and while conditions constant propagation decided
+    size_t folded_branches = 0;
+    // expressions the parser looked up while hash-consing, the ones it found, and the distinct ones it kept
+    size_t intern_lookups = 0;
+    size_t intern_hits = 0;
+    size_t intern_unique = 0;
+};
+
+struct AnalysisStats {
+    std::vector<PhaseStats> phases;
+    StructureStats structure;
+    AnalysisCounters counters;
+};
+
+// Does what analyse_source does, measuring every phase on the way. Allocation counting is switched on for the
+// whole process by the first call.
+std::vector<UnusedAssignment> analyse_source_with_stats(std::string_view src, AnalysisStats &stats,
+                                                        const PhaseMemory &memory = {}, bool hash_cons = false);
+
+// An aligned table for people.
+std::string format_stats_text(const AnalysisStats &stats);
+
+// A single JSON object on one line.
+std::string format_stats_json(const AnalysisStats &stats);
+
+#endif //DFA_SAMPLE_STATS_HPP
@@ -0,0 +1,130 @@
+#include "streaming.hpp"
+#include <algorithm>
+#include "cfg.hpp"
+#include "dfg.hpp"
+#include "parse.hpp"
+#include "trace.hpp"
+
+// Statements are parsed from a window of the source this long at first, which doubles whenever a statement does
+// not end inside it.
+static constexpr size_t initial_window = size_t{1} << 20;
+
+// Parses the statement at `start` of `src` into `program`, and returns where the next one starts.
+static size_t parse_statement_at(const std::string_view src, const size_t start, size_t &window, Program &program) {
+    for (;;) {
+        const std::string_view text = src.substr(start, std::min(window, Span::max_offset));
+        const bool last_window = start + text.size() == src.size() || window >= Span::max_offset;
+        try {
+            ParserState state{Lexer{text}};
+            program.statements.statements.clear();
+            program.statements.statements.push_back(parse_statement(state));
+            state.lexer.skip_whitespace();
+            // a statement that runs into the end of the window may go on after it
+            if (!state.lexer.eof() || start + text.size() == src.size()) {
+                return start + state.lexer.pos;
+            }
+            if (last_window) {
+                throw std::runtime_error("Statement too large, a single statement is limited to 4 GiB");
+            }
+        } catch (const std::runtime_error &) {
+            if (last_window) {
+                throw;
+            }
+        }
+        window *= 2;
+    }
+}
+
+// Moves `line` and `line_start` past the line breaks in `text`, which starts at `offset`.
+static void advance_lines(const std::string_view text, const size_t offset, size_t &line, size_t &line_start) {
+    line += std::ranges::count(text, '\n');
+    if (const size_t last = text.rfind('\n'); last != std::string_view::npos) {
+        line_start = offset + last + 1;
+    }
+}
+
+StreamIndex index_statements(const std::string_view src) {
+    TraceScope trace{"index_statements"};
+    StreamIndex index;
+    index.end = src.size();
+    size_t start = 0;
+    while (start < src.size() && is_space(src[start])) {
+        start++;
+    }
+    size_t line = 1;
+    size_t line_start = 0;
+    advance_lines(src.substr(0, start), 0, line, line_start);
+
+    ConstantState constants;
+    size_t window = initial_window;
+    Program program;
+    DfgNodeOutputs names;
+    while (start < src.size()) {
+        const size_t next = parse_statement_at(src, start, window, program);
+        if (index.constants.empty() || index.constants.back() != constants) {
+            index.constants.push_back(constants);
+        }
+        index.statements.push_back(StreamedStatement{
+                .start = start,
+                .line = line,
+                .line_start = line_start,
+                .constants = static_cast<uint32_t>(index.constants.size() - 1),
+        });
+        Cfg cfg = build_cfg(program);
+        fold_constant_branches(cfg, constants);
+        compute_whole_program_required_outputs(program, names);
+        index.whole_program_outputs.out.insert(names.out.begin(), names.out.end());
+        index.max_statement_size = std::max(index.max_statement_size, next - start);
+        advance_lines(src.substr(start, next - start), start, line, line_start);
+        start = next;
+    }
+    return index;
+}
+
+std::vector<UnusedAssignment> analyse_indexed_source(const std::string_view src, const StreamIndex &index) {
+    TraceScope trace{"analyse_indexed_source"};
+    std::vector<UnusedAssignment> result;
+    DfgNodeInputs live_out{index.whole_program_outputs.out};
+    const size_t n = index.statements.size();
+    for (size_t i = n; i-- > 0;) {
+        const StreamedStatement &statement = index.statements[i];
+        const size_t end = i + 1 < n ? index.statements[i + 1].start : index.end;
+        const std::string_view text = src.substr(statement.start, end - statement.start);
+
+        ParserState state{Lexer{text}};
+        Program program;
+        program.statements.statements.push_back(parse_statement(state));
+        const LineIndex lines = std::move(state.lexer.lines);
+        Cfg cfg = build_cfg(program);
+        ConstantState constants = index.constants[statement.constants];
+        fold_constant_branches(cfg, constants);
+        const Dfg dfg = build_dfg(cfg);
+
+        DfgNodeUnusedAssignments unused_assignments;
+        DfgNodeInputs live_in;
+        analyse_dfg_region(dfg, index.whole_program_outputs, live_out, i + 1 < n, unused_assignments, live_in);
+        live_out = std::move(live_in);
+
+        // backwards, like the statements, so that reversing the whole result at the end sorts it
+        std::ranges::sort(unused_assignments.assignments,
+                          [](const auto &a, const auto &b) {
+                              return a->span.start > b->span.start;
+                          });
+        for (const auto &assignment: unused_assignments.assignments) {
+            const auto [line, column] = lines.locate(assignment->span.start);
+            result.push_back(UnusedAssignment{
+                    .name = assignment->name.name,
+                    .start = statement.start + assignment->span.start,
+                    .end = statement.start + assignment->span.end,
+                    .line = statement.line + line - 1,
+                    .column = line == 1 ? statement.start + assignment->span.start - statement.line_start + 1 : column,
+            });
+        }
+    }
+    std::ranges::reverse(result);
+    return result;
+}
+
+std::vector<UnusedAssignment> analyse_source_streaming(const std::string_view src) {
+    return analyse_indexed_source(src, index_statements(src));
+}
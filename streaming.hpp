@@ -0,0 +1,48 @@
+#ifndef DFA_SAMPLE_STREAMING_HPP
+#define DFA_SAMPLE_STREAMING_HPP
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "analysis.hpp"
+#include "constant_propagation.hpp"
+#include "dfg_analysis.hpp"
+
+// A top-level statement of the source, found by the forward pass.
+struct StreamedStatement {
+    // offset of the statement, which runs with the whitespace after it up to the next statement's start
+    size_t start;
+    // the line the statement starts on (1-based), and the offset that line starts at
+    size_t line;
+    size_t line_start;
+    // index into StreamIndex::constants of the constants the statements before it leave
+    uint32_t constants;
+};
+
+// What the backward pass needs to know about the statements before and after the one it analyses.
+struct StreamIndex {
+    std::vector<StreamedStatement> statements;
+    // the constant states the statements start from, with consecutive repeats stored once
+    std::vector<ConstantState> constants;
+    DfgNodeOutputs whole_program_outputs;
+    // the longest statement, which bounds the memory of the backward pass
+    size_t max_statement_size = 0;
+    // the size of the source
+    size_t end = 0;
+};
+
+// The forward pass: parses the top-level statements one at a time from windows of `src`, and keeps their offsets,
+// the constants they start from and the variables in the program, but not their trees. Unlike parse_program it
+// is not limited to 4 GiB sources, only to statements of up to 4 GiB each. Throws std::runtime_error on a parse
+// error.
+StreamIndex index_statements(std::string_view src);
+
+// The backward pass: parses, folds and analyses the statements of `index` again one at a time from the last to
+// the first, carrying only the variables live between them. The results are those of analyse_source over
+// `src`, which must be what `index` was built from.
+std::vector<UnusedAssignment> analyse_indexed_source(std::string_view src, const StreamIndex &index);
+
+// Both passes, holding the trees of a single top-level statement at a time.
+std::vector<UnusedAssignment> analyse_source_streaming(std::string_view src);
+
+#endif //DFA_SAMPLE_STREAMING_HPP
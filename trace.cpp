@@ -0,0 +1,121 @@
+#include "trace.hpp"
+
+#if DFA_TRACING
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "reporter.hpp"
+
+std::atomic<bool> tracing_enabled{false};
+
+struct ThreadTraceBuffer {
+    size_t thread_id;
+    std::vector<TraceEvent> events;
+};
+
+// Buffers outlive their threads, so that batch workers that have finished still get written out.
+static std::mutex trace_registry_mutex;
+static std::vector<std::unique_ptr<ThreadTraceBuffer>> trace_buffers;
+static thread_local ThreadTraceBuffer *thread_trace_buffer = nullptr;
+static int trace_fd = -1;
+static const std::chrono::steady_clock::time_point trace_epoch = std::chrono::steady_clock::now();
+
+uint64_t trace_clock_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - trace_epoch)
+            .count();
+}
+
+void record_trace_event(const TraceEvent &event) {
+    if (thread_trace_buffer == nullptr) {
+        std::lock_guard lock{trace_registry_mutex};
+        auto buffer = std::make_unique<ThreadTraceBuffer>();
+        buffer->thread_id = trace_buffers.size() + 1;
+        buffer->events.reserve(1 << 12);
+        thread_trace_buffer = buffer.get();
+        trace_buffers.push_back(std::move(buffer));
+    }
+    thread_trace_buffer->events.push_back(event);
+}
+
+bool start_tracing(const char *path) {
+    trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (trace_fd < 0) {
+        return false;
+    }
+    std::atexit(finish_tracing);
+    tracing_enabled.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+static void append_microseconds(ReportBuffer &out, const uint64_t ns) {
+    out.append_number(ns / 1000);
+    char fraction[8];
+    std::snprintf(fraction, sizeof(fraction), ".%03u", static_cast<unsigned>(ns % 1000));
+    out.append(fraction);
+}
+
+void finish_tracing() {
+    if (!tracing_enabled.exchange(false)) {
+        return;
+    }
+    std::lock_guard lock{trace_registry_mutex};
+    {
+        ReportBuffer out{trace_fd};
+        out.append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        bool first = true;
+        for (const auto &buffer: trace_buffers) {
+            for (const TraceEvent &event: buffer->events) {
+                out.append(first ? "" : ",\n");
+                first = false;
+                out.append("{\"name\":");
+                out.append_json_string(event.name);
+                out.append(",\"cat\":\"dfa\",\"ph\":\"X\",\"pid\":1,\"tid\":");
+                out.append_number(buffer->thread_id);
+                out.append(",\"ts\":");
+                append_microseconds(out, event.start_ns);
+                out.append(",\"dur\":");
+                append_microseconds(out, event.duration_ns);
+                if (event.arg_names[0] != nullptr || event.arg_names[1] != nullptr) {
+                    out.append(",\"args\":{");
+                    for (unsigned i = 0; i < 2; i++) {
+                        if (event.arg_names[i] == nullptr) {
+                            continue;
+                        }
+                        if (i == 1 && event.arg_names[0] != nullptr) {
+                            out.append(',');
+                        }
+                        out.append_json_string(event.arg_names[i]);
+                        out.append(':');
+                        out.append_number(event.arg_values[i]);
+                    }
+                    out.append('}');
+                }
+                out.append('}');
+            }
+        }
+        out.append("\n]}\n");
+        if (!out.flush()) {
+            std::fprintf(stderr, "Failed to write trace: %s\n", std::strerror(out.error()));
+        }
+    }
+    close(trace_fd);
+    trace_fd = -1;
+}
+
+#else
+
+bool start_tracing(const char *) {
+    return false;
+}
+
+void finish_tracing() {
+}
+
+#endif
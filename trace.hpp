@@ -0,0 +1,82 @@
+#ifndef DFA_SAMPLE_TRACE_HPP
+#define DFA_SAMPLE_TRACE_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// Scoped events in the Chrome trace-event format, for chrome://tracing or Perfetto. Every thread records into a
+// buffer of its own; the buffers are written out together when tracing finishes. Building with DFA_TRACING=0
+// removes the instrumentation entirely, and with it built in but not started, a scope costs a relaxed load.
+
+#ifndef DFA_TRACING
+#define DFA_TRACING 1
+#endif
+
+// Starts recording, to be written to `path` by finish_tracing (or at exit). Returns false if the file cannot be
+// created or tracing is compiled out.
+bool start_tracing(const char *path);
+
+// Writes out everything recorded. No thread may be recording anymore.
+void finish_tracing();
+
+#if DFA_TRACING
+
+extern std::atomic<bool> tracing_enabled;
+
+struct TraceEvent {
+    const char *name;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    // up to two named integer arguments, unused ones have a null name
+    const char *arg_names[2];
+    uint64_t arg_values[2];
+};
+
+uint64_t trace_clock_ns();
+
+void record_trace_event(const TraceEvent &event);
+
+// Records the time from construction to destruction as one complete event.
+class TraceScope {
+    TraceEvent event{};
+    bool active;
+
+public:
+    explicit TraceScope(const char *name) : active(tracing_enabled.load(std::memory_order_relaxed)) {
+        if (active) {
+            event.name = name;
+            event.start_ns = trace_clock_ns();
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+    ~TraceScope() {
+        if (active) {
+            event.duration_ns = trace_clock_ns() - event.start_ns;
+            record_trace_event(event);
+        }
+    }
+
+    // `index` is 0 or 1
+    void arg(const unsigned index, const char *name, const uint64_t value) {
+        event.arg_names[index] = name;
+        event.arg_values[index] = value;
+    }
+};
+
+#else
+
+class TraceScope {
+public:
+    explicit TraceScope(const char *) {
+    }
+
+    void arg(unsigned, const char *, uint64_t) {
+    }
+};
+
+#endif
+
+#endif //DFA_SAMPLE_TRACE_HPP
@@ -0,0 +1,241 @@
+#include "use_def.hpp"
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <numeric>
+#include "trace.hpp"
+#include "visitor.hpp"
+
+static constexpr size_t variable_count = 256;
+
+// The names an expression reads, with their spans.
+struct UseCollector : public StaticAstVisitor<UseCollector> {
+    std::vector<Name> names;
+
+    void visit_name(const Name &name) {
+        names.push_back(name);
+    }
+};
+
+// One bit per definition id, with an extra id per variable after the assignments standing for the value it
+// had at the program entry.
+class DefinitionSet {
+    std::vector<uint64_t> words;
+
+public:
+    explicit DefinitionSet(const size_t bits) : words((bits + 63) / 64) {
+    }
+
+    [[nodiscard]] bool contains(const uint32_t id) const {
+        return (words[id / 64] >> (id % 64) & 1) != 0;
+    }
+
+    void insert(const uint32_t id) {
+        words[id / 64] |= uint64_t{1} << (id % 64);
+    }
+
+    void remove_all(const DefinitionSet &other) {
+        for (size_t i = 0; i < words.size(); i++) {
+            words[i] &= ~other.words[i];
+        }
+    }
+
+    // returns whether anything was added
+    bool insert_all(const DefinitionSet &other) {
+        uint64_t added = 0;
+        for (size_t i = 0; i < words.size(); i++) {
+            added |= other.words[i] & ~words[i];
+            words[i] |= other.words[i];
+        }
+        return added != 0;
+    }
+};
+
+// What a basic block does to the definitions going through it: it kills every definition of the variables it
+// assigns, and then adds the last assignment to each of them.
+struct BlockTransfer {
+    std::vector<unsigned char> killed;
+    std::vector<uint32_t> generated;
+};
+
+std::optional<uint32_t> UseDefChains::definition_at(const Span span) const {
+    const auto it = definition_starts.find(span.start);
+    if (it == definition_starts.end() || definitions[it->second]->span.end != span.end) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::optional<uint32_t> UseDefChains::use_at(const Span span) const {
+    const auto it = use_starts.find(span.start);
+    if (it == use_starts.end() || uses[it->second].span.end != span.end) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+UseDefChains build_use_def_chains(const Dfg &dfg) {
+    TraceScope trace{"build_use_def_chains"};
+    UseDefChains chains;
+    const size_t node_count = dfg.nodes.size();
+    std::unordered_map<const DfgNode *, uint32_t> node_ids;
+    for (size_t i = 0; i < node_count; i++) {
+        node_ids.emplace(dfg.nodes[i].get(), static_cast<uint32_t>(i));
+        if (const auto *block = std::get_if<BasicCfgBlock>(&dfg.nodes[i]->cfg_node->node)) {
+            for (const auto &assignment: block->assignments) {
+                if (assignment->name.name.length() != 1) {
+                    throw std::runtime_error("Invalid name length");
+                }
+                chains.definitions.push_back(assignment);
+            }
+        }
+    }
+    std::ranges::sort(chains.definitions, {}, [](const auto &assignment) {
+        return assignment->span.start;
+    });
+    const auto definition_count = static_cast<uint32_t>(chains.definitions.size());
+    const size_t bits = definition_count + variable_count;
+    std::unordered_map<const AssignmentCfgNode *, uint32_t> definition_ids;
+    std::array<std::vector<uint32_t>, variable_count> variable_definitions;
+    for (uint32_t id = 0; id < definition_count; id++) {
+        const AssignmentCfgNode &assignment = *chains.definitions[id];
+        definition_ids.emplace(&assignment, id);
+        chains.definition_starts.emplace(assignment.span.start, id);
+        variable_definitions[static_cast<unsigned char>(assignment.name.name[0])].push_back(id);
+    }
+    std::vector<DefinitionSet> variable_sets(variable_count, DefinitionSet{bits});
+    DefinitionSet entry{bits};
+    for (size_t v = 0; v < variable_count; v++) {
+        const auto entry_id = static_cast<uint32_t>(definition_count + v);
+        variable_definitions[v].push_back(entry_id);
+        for (const uint32_t id: variable_definitions[v]) {
+            variable_sets[v].insert(id);
+        }
+        entry.insert(entry_id);
+    }
+
+    std::vector<BlockTransfer> transfers(node_count);
+    std::vector<std::vector<uint32_t>> successors(node_count);
+    for (size_t i = 0; i < node_count; i++) {
+        for (const auto &out_node: dfg.nodes[i]->out_nodes) {
+            successors[i].push_back(node_ids.at(out_node.lock().get()));
+        }
+        if (const auto *block = std::get_if<BasicCfgBlock>(&dfg.nodes[i]->cfg_node->node)) {
+            std::array<std::optional<uint32_t>, variable_count> last{};
+            for (const auto &assignment: block->assignments) {
+                last[static_cast<unsigned char>(assignment->name.name[0])] = definition_ids.at(assignment.get());
+            }
+            for (size_t v = 0; v < variable_count; v++) {
+                if (last[v]) {
+                    transfers[i].killed.push_back(static_cast<unsigned char>(v));
+                    transfers[i].generated.push_back(*last[v]);
+                }
+            }
+        }
+    }
+    const auto apply_transfer = [&](const size_t node, DefinitionSet &set) {
+        for (const unsigned char v: transfers[node].killed) {
+            set.remove_all(variable_sets[v]);
+        }
+        for (const uint32_t id: transfers[node].generated) {
+            set.insert(id);
+        }
+    };
+
+    // the definitions reaching the start of each node, until nothing changes anymore
+    std::vector<DefinitionSet> reaching(node_count, DefinitionSet{bits});
+    if (node_count != 0) {
+        // the entry node is always the first one built, see build_dfg_nodes
+        reaching[0] = entry;
+    }
+    std::deque<uint32_t> work_list(node_count);
+    std::iota(work_list.begin(), work_list.end(), 0);
+    std::vector<bool> queued(node_count, true);
+    while (!work_list.empty()) {
+        const uint32_t node = work_list.front();
+        work_list.pop_front();
+        queued[node] = false;
+        DefinitionSet out = reaching[node];
+        apply_transfer(node, out);
+        for (const uint32_t successor: successors[node]) {
+            if (reaching[successor].insert_all(out) && !queued[successor]) {
+                queued[successor] = true;
+                work_list.push_back(successor);
+            }
+        }
+    }
+
+    // the chains of every use, in the order the nodes are found in
+    std::vector<Name> uses;
+    std::vector<bool> reached_from_entry;
+    std::vector<uint32_t> offsets{0};
+    std::vector<uint32_t> targets;
+    const auto add_uses = [&](const Expr &expr, const DefinitionSet &set) {
+        UseCollector collector;
+        collector.visit_expr(expr);
+        for (const Name &name: collector.names) {
+            const auto v = static_cast<unsigned char>(name.name[0]);
+            for (const uint32_t id: variable_definitions[v]) {
+                if (id < definition_count && set.contains(id)) {
+                    targets.push_back(id);
+                }
+            }
+            uses.push_back(name);
+            reached_from_entry.push_back(set.contains(definition_count + v));
+            offsets.push_back(static_cast<uint32_t>(targets.size()));
+        }
+    };
+    for (size_t i = 0; i < node_count; i++) {
+        std::visit([&]<typename T0>(T0 &&node) {
+            using T = std::decay_t<T0>;
+            if constexpr (std::is_same_v<T, BasicCfgBlock>) {
+                DefinitionSet set = reaching[i];
+                for (const auto &assignment: node.assignments) {
+                    add_uses(*assignment->expr, set);
+                    set.remove_all(variable_sets[static_cast<unsigned char>(assignment->name.name[0])]);
+                    set.insert(definition_ids.at(assignment.get()));
+                }
+            } else if constexpr (std::is_same_v<T, IfCfgNode>) {
+                add_uses(*node.condition, reaching[i]);
+            } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileCfgNode>>) {
+                add_uses(*node->condition, reaching[i]);
+            } else if constexpr (std::is_same_v<T, std::shared_ptr<WhileRetDummyCfgNode>>
+                                 || std::is_same_v<T, ExitCfgNode>) {
+            } else {
+                static_assert(false, "non-exhaustive visitor!");
+            }
+        }, dfg.nodes[i]->cfg_node->node);
+    }
+
+    // renumber the uses in source order
+    std::vector<uint32_t> order(uses.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::sort(order, {}, [&](const uint32_t use) {
+        return uses[use].span.start;
+    });
+    chains.use_def_offsets.push_back(0);
+    for (const uint32_t use: order) {
+        const auto id = static_cast<uint32_t>(chains.uses.size());
+        chains.uses.push_back(uses[use]);
+        chains.reached_from_entry.push_back(reached_from_entry[use]);
+        chains.use_starts.emplace(uses[use].span.start, id);
+        chains.use_def_targets.insert(chains.use_def_targets.end(), targets.begin() + offsets[use],
+                                      targets.begin() + offsets[use + 1]);
+        chains.use_def_offsets.push_back(static_cast<uint32_t>(chains.use_def_targets.size()));
+    }
+
+    // and transpose them
+    chains.def_use_offsets.assign(definition_count + 1, 0);
+    for (const uint32_t definition: chains.use_def_targets) {
+        chains.def_use_offsets[definition + 1]++;
+    }
+    std::partial_sum(chains.def_use_offsets.begin(), chains.def_use_offsets.end(), chains.def_use_offsets.begin());
+    chains.def_use_targets.resize(chains.use_def_targets.size());
+    std::vector<uint32_t> filled(chains.def_use_offsets.begin(), chains.def_use_offsets.end() - 1);
+    for (uint32_t use = 0; use < chains.uses.size(); use++) {
+        for (const uint32_t definition: chains.definitions_reaching(use)) {
+            chains.def_use_targets[filled[definition]++] = use;
+        }
+    }
+    return chains;
+}
@@ -0,0 +1,75 @@
+#ifndef DFA_SAMPLE_USE_DEF_HPP
+#define DFA_SAMPLE_USE_DEF_HPP
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include "dfg.hpp"
+
+// Which assignments reach each read of a variable, and which reads each assignment reaches, found by a reaching
+// definitions analysis over a DFG, with variables told apart by their first character like the liveness analysis
+// does. The definitions are the assignments and the uses are the names read by right-hand sides and conditions,
+// both numbered in source order. The chains are stored in CSR form: the ids for entry i are the ones from
+// offsets[i] to offsets[i + 1] of the targets, in increasing order.
+class UseDefChains {
+    std::vector<std::shared_ptr<AssignmentCfgNode>> definitions;
+    std::vector<Name> uses;
+    // whether the value a variable had when the program started may reach the use
+    std::vector<bool> reached_from_entry;
+
+    std::vector<uint32_t> use_def_offsets;
+    std::vector<uint32_t> use_def_targets;
+    std::vector<uint32_t> def_use_offsets;
+    std::vector<uint32_t> def_use_targets;
+
+    // by span start
+    std::unordered_map<uint32_t, uint32_t> definition_starts;
+    std::unordered_map<uint32_t, uint32_t> use_starts;
+
+    friend UseDefChains build_use_def_chains(const Dfg &dfg);
+
+public:
+    [[nodiscard]] size_t definition_count() const {
+        return definitions.size();
+    }
+
+    [[nodiscard]] size_t use_count() const {
+        return uses.size();
+    }
+
+    [[nodiscard]] const AssignmentCfgNode &definition(const uint32_t id) const {
+        return *definitions[id];
+    }
+
+    [[nodiscard]] const Name &use(const uint32_t id) const {
+        return uses[id];
+    }
+
+    [[nodiscard]] bool use_reached_from_entry(const uint32_t use) const {
+        return reached_from_entry[use];
+    }
+
+    // the assignments that may have written the value `use` reads
+    [[nodiscard]] std::span<const uint32_t> definitions_reaching(const uint32_t use) const {
+        return std::span{use_def_targets}.subspan(use_def_offsets[use], use_def_offsets[use + 1] - use_def_offsets[use]);
+    }
+
+    // the reads that may see the value `definition` writes
+    [[nodiscard]] std::span<const uint32_t> uses_reached(const uint32_t definition) const {
+        return std::span{def_use_targets}.subspan(def_use_offsets[definition],
+                                                  def_use_offsets[definition + 1] - def_use_offsets[definition]);
+    }
+
+    // the assignment or the read with exactly this span, if any
+    [[nodiscard]] std::optional<uint32_t> definition_at(Span span) const;
+    [[nodiscard]] std::optional<uint32_t> use_at(Span span) const;
+};
+
+// Runs the analysis over `dfg`, leaving out the edges folded away. The spans tell the uses apart, so the program
+// must not have been parsed with hash-consing. Throws std::runtime_error on an assignment to a longer name, like
+// analyse_dfg.
+UseDefChains build_use_def_chains(const Dfg &dfg);
+
+#endif //DFA_SAMPLE_USE_DEF_HPP
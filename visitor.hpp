@@ -73,4 +73,124 @@ struct AstVisitor {
     }
 };
 
+// The same traversal as AstVisitor, resolved at compile time. `Derived` declares the visit_* functions it handles,
+// hiding the defaults here, and calls the walk_* functions of this class where AstVisitor overrides would call
+// the free ones. Nothing is virtual, so whole traversals can be inlined; AstVisitor remains for visitors that
+// have to be picked at run time.
+template<typename Derived>
+struct StaticAstVisitor {
+    void visit_name(const Name &) {
+    }
+
+    void visit_constant(const Constant &) {
+    }
+
+    void visit_expr(const Expr &expr) {
+        walk_expr(expr);
+    }
+
+    void visit_paren_expr(const ParenExpr &paren_expr) {
+        walk_paren_expr(paren_expr);
+    }
+
+    void visit_binary_expr(const BinaryExpr &binary_expr) {
+        walk_binary_expr(binary_expr);
+    }
+
+    void visit_statement(const Stmt &stmt) {
+        walk_statement(stmt);
+    }
+
+    void visit_assignment_stmt(const AssignmentStmt &assignment_stmt) {
+        walk_assignment_stmt(assignment_stmt);
+    }
+
+    void visit_if_stmt(const IfStmt &if_stmt) {
+        walk_if_stmt(if_stmt);
+    }
+
+    void visit_while_stmt(const WhileStmt &while_stmt) {
+        walk_while_stmt(while_stmt);
+    }
+
+    void visit_stmt_list(const StmtList &stmt_list) {
+        walk_stmt_list(stmt_list);
+    }
+
+    void visit_program(const Program &program) {
+        walk_program(program);
+    }
+
+    void walk_expr(const Expr &expr) {
+        std::visit([&]<typename T0>(T0 &&arg) {
+            using T = std::decay_t<T0>;
+            if constexpr (std::is_same_v<T, Name>) {
+                derived().visit_name(arg);
+            } else if constexpr (std::is_same_v<T, Constant>) {
+                derived().visit_constant(arg);
+            } else if constexpr (std::is_same_v<T, ParenExpr>) {
+                derived().visit_paren_expr(arg);
+            } else if constexpr (std::is_same_v<T, BinaryExpr>) {
+                derived().visit_binary_expr(arg);
+            } else {
+                static_assert(false, "non-exhaustive visitor!");
+            }
+        }, expr.data);
+    }
+
+    void walk_paren_expr(const ParenExpr &paren_expr) {
+        derived().visit_expr(*paren_expr.expr);
+    }
+
+    void walk_binary_expr(const BinaryExpr &binary_expr) {
+        derived().visit_expr(*binary_expr.lhs);
+        derived().visit_expr(*binary_expr.rhs);
+    }
+
+    void walk_while_stmt(const WhileStmt &while_stmt) {
+        derived().visit_expr(*while_stmt.condition);
+        derived().visit_stmt_list(*while_stmt.body);
+    }
+
+    void walk_if_stmt(const IfStmt &if_stmt) {
+        derived().visit_expr(*if_stmt.condition);
+        derived().visit_stmt_list(*if_stmt.then_block);
+    }
+
+    void walk_assignment_stmt(const AssignmentStmt &assignment_stmt) {
+        derived().visit_name(assignment_stmt.lhs);
+        derived().visit_expr(*assignment_stmt.rhs);
+    }
+
+    void walk_statement(const Stmt &stmt) {
+        std::visit([&]<typename T0>(T0 &&arg) {
+            using T = std::decay_t<T0>;
+            if constexpr (std::is_same_v<T, AssignmentStmt>) {
+                derived().visit_assignment_stmt(arg);
+            } else if constexpr (std::is_same_v<T, IfStmt>) {
+                derived().visit_if_stmt(arg);
+            } else if constexpr (std::is_same_v<T, WhileStmt>) {
+                derived().visit_while_stmt(arg);
+            } else {
+                static_assert(false, "non-exhaustive visitor!");
+            }
+        }, stmt.data);
+    }
+
+    void walk_stmt_list(const StmtList &stmt_list) {
+        for (const Stmt &stmt: stmt_list.statements) {
+            derived().visit_statement(stmt);
+        }
+    }
+
+    void walk_program(const Program &program) {
+        derived().visit_stmt_list(program.statements);
+    }
+
+private:
+    Derived &derived() {
+        return static_cast<Derived &>(*this);
+    }
+};
+
 #endif //DFA_SAMPLE_VISITOR_HPP
@@ -0,0 +1,72 @@
+#include "work_stealing.hpp"
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<size_t> indices;
+
+    std::optional<size_t> pop_front() {
+        std::lock_guard lock{mutex};
+        if (indices.empty()) {
+            return std::nullopt;
+        }
+        const size_t index = indices.front();
+        indices.pop_front();
+        return index;
+    }
+
+    std::optional<size_t> steal_back() {
+        std::lock_guard lock{mutex};
+        if (indices.empty()) {
+            return std::nullopt;
+        }
+        const size_t index = indices.back();
+        indices.pop_back();
+        return index;
+    }
+};
+
+size_t default_thread_count() {
+    const size_t threads = std::thread::hardware_concurrency();
+    return threads == 0 ? 1 : threads;
+}
+
+void run_work_stealing(const size_t count, size_t threads,
+                       const std::function<void(size_t worker, size_t index)> &task) {
+    if (threads == 0) {
+        threads = default_thread_count();
+    }
+    threads = std::max<size_t>(1, std::min(threads, count));
+
+    std::vector<WorkerQueue> queues(threads);
+    for (size_t i = 0; i < count; i++) {
+        queues[i % threads].indices.push_back(i);
+    }
+
+    const auto work = [&](const size_t worker) {
+        while (true) {
+            std::optional<size_t> index = queues[worker].pop_front();
+            // no task ever adds more work, so once every queue is empty we are done
+            for (size_t i = 1; !index && i < threads; i++) {
+                index = queues[(worker + i) % threads].steal_back();
+            }
+            if (!index) {
+                return;
+            }
+            task(worker, *index);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t worker = 1; worker < threads; worker++) {
+        workers.emplace_back(work, worker);
+    }
+    work(0);
+    for (auto &worker: workers) {
+        worker.join();
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef DFA_SAMPLE_WORK_STEALING_HPP
+#define DFA_SAMPLE_WORK_STEALING_HPP
+
+#include <cstddef>
+#include <functional>
+
+// Runs task(worker, index) for every index in [0, count) on `threads` threads (all hardware threads if 0).
+// Indices are dealt round-robin into per-worker queues; a worker takes its own indices in increasing order and
+// steals the highest pending ones of other workers once it runs out. Returns once every task has run. The calling
+// thread is worker 0, and tasks must not throw.
+void run_work_stealing(size_t count, size_t threads, const std::function<void(size_t worker, size_t index)> &task);
+
+size_t default_thread_count();
+
+#endif //DFA_SAMPLE_WORK_STEALING_HPP